@@ -14,11 +14,19 @@
  */
 
 #include "abledoom.hpp"
+#include "abledoom_pixels.hpp"
 
 #include "doomgeneric.h"
 #include "doomkeys.h"
 #include "doomstat.h"
 #include "doomtype.h"
+#include "st_stuff.h"
+
+extern "C"
+{
+#include "i_perf.h"
+#include "m_argv.h"
+}
 
 #include <algorithm>
 #include <cmath>
@@ -113,22 +121,26 @@ bool isPad(uint8_t noteNumber)
 }
 
 
-std::tuple<uint8_t, uint8_t> noteNumberToPadCoordinate(uint8_t noteNumber)
+constexpr uint8_t padNoteNumber(const PadId& pad)
 {
-  const auto iRowStart = std::find_if(
-    std::begin(Y_TO_PAD_ROW_START),
-    std::end(Y_TO_PAD_ROW_START),
-    [&noteNumber](int value) { return noteNumber >= value; });
+  return uint8_t(Y_TO_PAD_ROW_START[pad.y] + pad.x);
+}
 
-  if (iRowStart != std::end(Y_TO_PAD_ROW_START))
+
+// MIDI note number to pad coordinate, only meaningful where isPad() is true
+constexpr auto NOTE_TO_PAD = []() {
+  std::array<PadId, 128> result{};
+
+  for (uint8_t y = 0; y < 8; ++y)
   {
-    return std::make_tuple(
-      uint8_t(noteNumber - *iRowStart),
-      uint8_t(std::distance(std::begin(Y_TO_PAD_ROW_START), iRowStart)));
+    for (uint8_t x = 0; x < 8; ++x)
+    {
+      result[padNoteNumber(PadId{x, y})] = PadId{x, y};
+    }
   }
 
-  return std::make_tuple(0, 0);
-}
+  return result;
+}();
 
 
 bool isPushPort(const std::string& portName)
@@ -138,33 +150,98 @@ bool isPushPort(const std::string& portName)
 }
 
 
-void initializeMidiIo(RtMidiIn& midiIn, RtMidiOut& midiOut)
+void throwAlsaError(int errorCode)
 {
-  // Open Push MIDI input port for receiving button/pad presses
-  std::optional<unsigned int> portNumber;
+  using namespace std::string_literals;
+
+  throw std::runtime_error("ALSA error: "s + snd_strerror(errorCode));
+}
+
+
+// Opens a non-blocking ALSA sequencer client, connected to the Push MIDI output port
+// for receiving button/pad presses
+snd_seq_t* openMidiInput()
+{
+  snd_seq_t* pSeq = nullptr;
 
-  for (auto i = 0u; i < midiIn.getPortCount(); ++i)
+  if (const auto result =
+        snd_seq_open(&pSeq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK);
+      result < 0)
   {
-    const auto& portName = midiIn.getPortName(i);
-    if (isPushPort(portName))
-    {
-      portNumber = i;
-      break;
-    }
+    throwAlsaError(result);
   }
 
-  if (portNumber)
+  snd_seq_set_client_name(pSeq, "AbleDOOM");
+
+  const auto ownPort = snd_seq_create_simple_port(
+    pSeq,
+    "AbleDOOM Input",
+    SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+    SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+
+  if (ownPort < 0)
   {
-    midiIn.openPort(*portNumber, "");
+    snd_seq_close(pSeq);
+    throwAlsaError(ownPort);
   }
-  else
+
+  // Find the Push port. Port names are built the same way RtMidi does it, so that
+  // isPushPort() matches the same ports as it does for output.
+  snd_seq_client_info_t* pClientInfo;
+  snd_seq_port_info_t* pPortInfo;
+  snd_seq_client_info_alloca(&pClientInfo);
+  snd_seq_port_info_alloca(&pPortInfo);
+
+  constexpr auto kRequiredCaps = SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ;
+
+  snd_seq_client_info_set_client(pClientInfo, -1);
+
+  while (snd_seq_query_next_client(pSeq, pClientInfo) >= 0)
   {
-    throw std::runtime_error("Couldn't open MIDI in port");
+    const auto client = snd_seq_client_info_get_client(pClientInfo);
+
+    snd_seq_port_info_set_client(pPortInfo, client);
+    snd_seq_port_info_set_port(pPortInfo, -1);
+
+    while (snd_seq_query_next_port(pSeq, pPortInfo) >= 0)
+    {
+      const auto type = snd_seq_port_info_get_type(pPortInfo);
+      const auto caps = snd_seq_port_info_get_capability(pPortInfo);
+
+      if (
+        (type & (SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_SYNTH)) == 0
+        || (caps & kRequiredCaps) != kRequiredCaps)
+      {
+        continue;
+      }
+
+      const auto port = snd_seq_port_info_get_port(pPortInfo);
+      const auto portName = std::string{snd_seq_client_info_get_name(pClientInfo)}
+        + " " + std::to_string(client) + ":" + std::to_string(port);
+
+      if (isPushPort(portName))
+      {
+        if (const auto result = snd_seq_connect_from(pSeq, ownPort, client, port);
+            result < 0)
+        {
+          snd_seq_close(pSeq);
+          throwAlsaError(result);
+        }
+
+        return pSeq;
+      }
+    }
   }
 
+  snd_seq_close(pSeq);
+  throw std::runtime_error("Couldn't open MIDI in port");
+}
+
 
+void initializeMidiOut(RtMidiOut& midiOut)
+{
   // Open Push MIDI output port for setting LED lights
-  portNumber.reset();
+  std::optional<unsigned int> portNumber;
 
   for (auto i = 0u; i < midiOut.getPortCount(); ++i)
   {
@@ -255,45 +332,19 @@ libusb_device_handle* openPushDisplayUsbDevice()
 }
 
 
-// See
-// https://github.com/Ableton/push-interface/blob/main/doc/AbletonPush2MIDIDisplayInterface.asc#xoring-pixel-data
-void applySignalShapingPattern(uint8_t* pBuffer)
-{
-  auto pBufferDataAsUint32 = reinterpret_cast<uint32_t*>(pBuffer);
-  for (auto i = 0u; i < PUSH_SCREEN_SIZE_BYTES / sizeof(uint32_t); ++i)
-  {
-    pBufferDataAsUint32[i] ^= 0xffe7f3e7;
-  }
-}
-
-
-// Kick-off libusb transfers for a single frame of Push display data
-void submitDisplayFrameTransfer(PushHardware::DisplayData* pData)
+// Kick-off a libusb transfer, keeping track of how many are in flight. Returns false
+// if it couldn't be submitted, with the error stored in mDisplayError.
+bool submitDisplayTransfer(PushHardware::DisplayData* pData, libusb_transfer* pTransfer)
 {
-  if (const auto result = libusb_submit_transfer(pData->mpHeaderTransfer); result < 0)
+  if (const auto result = libusb_submit_transfer(pTransfer); result < 0)
   {
     pData->mDisplayError = result;
-    return;
-  }
-
-  if (const auto result = libusb_submit_transfer(pData->mpDataTransfer); result < 0)
-  {
-    pData->mDisplayError = result;
-    return;
+    return false;
   }
 
   // Make sure we don't try to send another frame while this one is still being sent
-  pData->mTransferInProgress = true;
-}
-
-// Pack color into the 16-bit format expected by the Push display
-uint16_t toBGR565(uint32_t color)
-{
-  const auto r = (color & 0x00FF0000) >> 16;
-  const auto g = (color & 0x0000FF00) >> 8;
-  const auto b = (color & 0x000000FF);
-
-  return ((b & 0xF8) << 8) | ((g & 0xFC) << 3) | (r >> 3);
+  ++pData->mTransfersInFlight;
+  return true;
 }
 
 } // namespace
@@ -308,6 +359,8 @@ static void LIBUSB_CALL onTransferFinished(libusb_transfer* transfer)
 
   auto pData = static_cast<PushHardware::DisplayData*>(transfer->user_data);
 
+  --pData->mTransfersInFlight;
+
   if (
     transfer->status != LIBUSB_TRANSFER_COMPLETED
     || transfer->length != transfer->actual_length)
@@ -315,46 +368,76 @@ static void LIBUSB_CALL onTransferFinished(libusb_transfer* transfer)
     // We could do more sophisticated error handling/recovery here, but for now, just
     // bail out if a transfer fails or can only be partially sent
     pData->mTransferFailed = true;
-    return;
-  }
-
-  if (transfer == pData->mpDataTransfer)
-  {
-    pData->mTransferInProgress = false;
   }
 }
 
 
 PushHardware::PushHardware(InputCallback inputCallback)
   : mInputCallback(std::move(inputCallback))
-  , mpMidiIn(std::make_unique<RtMidiIn>())
   , mpMidiOut(std::make_unique<RtMidiOut>())
 {
   mMessageBuffer.resize(3);
 
-  mpMidiIn->setCallback(onMessage, this);
+  initializeMidiOut(*mpMidiOut);
+  mpMidiIn = openMidiInput();
 
-  initializeMidiIo(*mpMidiIn, *mpMidiOut);
-
-  resetLEDs();
+  // The destructor doesn't run if the constructor throws
+  try
+  {
+    resetLEDs();
 
-  initDisplay();
+    initDisplay();
+  }
+  catch (...)
+  {
+    snd_seq_close(mpMidiIn);
+    throw;
+  }
 }
 
 
 PushHardware::~PushHardware()
 {
-  // Wait for any current transfers to complete
-  struct timeval tv;
-  tv.tv_sec = 30;
-  tv.tv_usec = 0;
-  libusb_handle_events_timeout(nullptr, &tv);
+  // Wait for any current transfers to complete. They all have a timeout, so this
+  // won't take forever.
+  while (mDisplayData.mTransfersInFlight > 0)
+  {
+    struct timeval tv;
+    tv.tv_sec = 30;
+    tv.tv_usec = 0;
+
+    if (libusb_handle_events_timeout(nullptr, &tv) < 0)
+    {
+      break;
+    }
+  }
+
+  for (const auto pTransfer : mDisplayData.mDataTransfers)
+  {
+    libusb_free_transfer(pTransfer);
+  }
 
-  libusb_free_transfer(mDisplayData.mpDataTransfer);
   libusb_free_transfer(mDisplayData.mpHeaderTransfer);
 
+#if LIBUSB_API_VERSION >= 0x01000105
+  if (mDisplayData.mUsbTransferBufferIsDevMem)
+  {
+    libusb_dev_mem_free(
+      mDisplayData.mpUsbDeviceHandle,
+      mDisplayData.mpUsbTransferBuffer,
+      PUSH_SCREEN_SIZE_BYTES);
+  }
+#endif
+
   libusb_release_interface(mDisplayData.mpUsbDeviceHandle, 0);
   libusb_close(mDisplayData.mpUsbDeviceHandle);
+
+  snd_seq_close(mpMidiIn);
+
+  printf(
+    "PushHardware: %d display frames sent, %d skipped as unchanged\n",
+    mFramesSent,
+    mFramesUnchanged);
 }
 
 
@@ -470,26 +553,53 @@ void PushHardware::copyToScreen(
     srcHeight = PUSH_SCREEN_HEIGHT - destY;
   }
 
-  // Copy the specified portion of the framebuffer, converting to Push pixel format as
-  // we go.
-  for (auto y = 0; y < srcHeight; ++y)
+  mScreenChanged = true;
+
+  // Out of room for deferring, so do the copies we have right away
+  if (mNumPendingCopies == mPendingCopies.size())
   {
-    for (auto x = 0; x < srcWidth; ++x)
-    {
-      mScreenBuffer[destX + x + (y + destY) * PUSH_SCREEN_STRIDE] =
-        toBGR565(srcBuffer[x + srcX + (y + srcY) * DOOMGENERIC_RESX]);
-    }
+    applyPendingCopies(0, PUSH_SCREEN_HEIGHT);
+    mNumPendingCopies = 0;
   }
+
+  mPendingCopies[mNumPendingCopies++] =
+    PendingCopy{srcBuffer, srcX, srcY, srcWidth, srcHeight, destX, destY};
 }
 
 
 void PushHardware::copyToScreen(const uint16_t* data)
 {
+  // This overwrites everything, so there's no point in doing any pending copies
+  mNumPendingCopies = 0;
+  mScreenChanged = true;
+
   // Copy raw data directly (must have the correct size)
   std::memcpy(mScreenBuffer.data(), data, mScreenBuffer.size() * sizeof(uint16_t));
 }
 
 
+void PushHardware::applyPendingCopies(int firstLine, int endLine)
+{
+  for (auto i = 0u; i < mNumPendingCopies; ++i)
+  {
+    const auto& copy = mPendingCopies[i];
+    const auto firstY = std::max(firstLine - copy.destY, 0);
+    const auto endY = std::min(endLine - copy.destY, copy.height);
+
+    // Copy the specified portion of the framebuffer, converting to Push pixel format
+    // as we go.
+    for (auto y = firstY; y < endY; ++y)
+    {
+      const auto pSrc = copy.srcBuffer + copy.srcX + (y + copy.srcY) * DOOMGENERIC_RESX;
+      const auto pDest =
+        mScreenBuffer.data() + copy.destX + (y + copy.destY) * PUSH_SCREEN_STRIDE;
+
+      convertToBGR565(pDest, pSrc, copy.width);
+    }
+  }
+}
+
+
 void PushHardware::submitScreen()
 {
   if (!mDisplayData.mTransferFailed && mDisplayData.mDisplayError >= 0)
@@ -520,89 +630,149 @@ void PushHardware::submitScreen()
   // we could wait but we simply drop it. This shouldn't really happen too often
   // in practice, since Doom only updates at 35 Hz whereas the Push display refresh rate
   // is 60 Hz.
-  if (mDisplayData.mTransferInProgress)
+  if (mDisplayData.mTransfersInFlight > 0)
+  {
+    // Still keep the screen buffer up to date
+    applyPendingCopies(0, PUSH_SCREEN_HEIGHT);
+    mNumPendingCopies = 0;
+    return;
+  }
+
+  // Don't send the same image again. Push turns its display off if it doesn't get a
+  // frame for a while though, so resend it every now and then.
+  const auto now = std::chrono::steady_clock::now();
+
+  if (!mScreenChanged && now - mLastSubmitTime < std::chrono::milliseconds{500})
+  {
+    ++mFramesUnchanged;
+    return;
+  }
+
+  mScreenChanged = false;
+  mLastSubmitTime = now;
+  ++mFramesSent;
+
+  // Send the header first, and then the frame chunk by chunk. Each chunk is converted
+  // and encoded right before it's submitted, while the previous ones are already
+  // being transferred. Stop at the first transfer that fails, the error is thrown on the
+  // next call.
+  if (!submitDisplayTransfer(&mDisplayData, mDisplayData.mpHeaderTransfer))
   {
     return;
   }
 
-  // Copy frame buffer into USB transfer buffer
-  std::memcpy(
-    mDisplayData.mUsbTransferBuffer.data(), mScreenBuffer.data(), PUSH_SCREEN_SIZE_BYTES);
+  const auto chunkLines = mDisplayData.mChunkLines;
+
+  for (auto i = 0u; i < mDisplayData.mDataTransfers.size(); ++i)
+  {
+    const auto firstLine = int(i) * chunkLines;
+    const auto endLine = std::min(firstLine + chunkLines, PUSH_SCREEN_HEIGHT);
+    const auto lineBytes = PUSH_SCREEN_STRIDE * sizeof(uint16_t);
+
+    applyPendingCopies(firstLine, endLine);
 
-  // Apply XOR pattern
-  applySignalShapingPattern(mDisplayData.mUsbTransferBuffer.data());
+    encodeDisplayData(
+      mDisplayData.mpUsbTransferBuffer + firstLine * lineBytes,
+      mScreenBuffer.data() + firstLine * PUSH_SCREEN_STRIDE,
+      (endLine - firstLine) * lineBytes);
 
-  // Kick-off USB transfers
-  submitDisplayFrameTransfer(&mDisplayData);
+    if (!submitDisplayTransfer(&mDisplayData, mDisplayData.mDataTransfers[i]))
+    {
+      break;
+    }
+  }
+
+  mNumPendingCopies = 0;
 }
 
 
-void PushHardware::onMessage(double, std::vector<unsigned char>* pMessage, void* pSelf)
+void PushHardware::pollInput()
 {
-  // Ignore any messages that aren't note on/off or CC
-  if (pMessage->size() != 3)
-    return;
+  // The ALSA sequencer hands out events from its own buffer, so there's nothing to
+  // allocate or decode here. In non-blocking mode, reading fails with -EAGAIN once
+  // there are no more events.
+  snd_seq_event_t* pEvent = nullptr;
 
-  const auto type = (*pMessage)[0] & 0b11110000;
-  const auto number = (*pMessage)[1];
-  const auto value = (*pMessage)[2];
+  for (;;)
+  {
+    const auto result = snd_seq_event_input(mpMidiIn, &pEvent);
 
-  const auto oEvent = [type, number, value]() -> std::optional<PushInputEvent> {
-    switch (type)
+    if (result == -ENOSPC)
     {
-    case 0x90: // Note On
-      if (isPad(number))
+      // Input buffer overrun - some events were lost, but we can keep reading
+      continue;
+    }
+
+    if (result < 0)
+    {
+      break;
+    }
+
+    // Ignore any events that aren't note on/off or CC
+    switch (pEvent->type)
+    {
+    case SND_SEQ_EVENT_NOTEON:
+      if (const auto number = pEvent->data.note.note & 0x7F; isPad(number))
       {
-        const auto [x, y] = noteNumberToPadCoordinate(number);
-        return PushInputEvent{PadId{x, y}, true};
+        mInputCallback(PushInputEvent{NOTE_TO_PAD[number], true});
       }
       break;
 
-    case 0x80: // Note Off
-      if (isPad(number))
+    case SND_SEQ_EVENT_NOTEOFF:
+      if (const auto number = pEvent->data.note.note & 0x7F; isPad(number))
       {
-        const auto [x, y] = noteNumberToPadCoordinate(number);
-        return PushInputEvent{PadId{x, y}, false};
+        mInputCallback(PushInputEvent{NOTE_TO_PAD[number], false});
       }
       break;
 
-    case 0xB0: // Control Change
-      return PushInputEvent{ButtonId{number}, value == 127};
+    case SND_SEQ_EVENT_CONTROLLER:
+      mInputCallback(PushInputEvent{
+        ButtonId(pEvent->data.control.param & 0x7F), pEvent->data.control.value == 127});
+      break;
 
     default:
       break;
     }
-
-    return {};
-  }();
-
-  if (oEvent)
-  {
-    static_cast<PushHardware*>(pSelf)->mInputCallback(*oEvent);
   }
 }
 
 
 void PushHardware::initDisplay()
 {
-  // Allocate buffers
-  mScreenBuffer.resize(PUSH_SCREEN_HEIGHT * PUSH_SCREEN_STRIDE);
-  mDisplayData.mUsbTransferBuffer.resize(PUSH_SCREEN_SIZE_BYTES);
+  //!
+  // @arg <n>
+  // @category obscure
+  //
+  // Number of display lines to send to Push per USB transfer (default 8).
+  //
+  char chunkLinesParm[] = "-pushchunklines";
+  if (const auto i = M_CheckParmWithArgs(chunkLinesParm, 1); i > 0)
+  {
+    mDisplayData.mChunkLines = std::clamp(atoi(myargv[i + 1]), 1, PUSH_SCREEN_HEIGHT);
+  }
 
   // Open the Push display USB device
   mDisplayData.mpUsbDeviceHandle = openPushDisplayUsbDevice();
 
-  // Allocate and set up USB transfers
-  mDisplayData.mpHeaderTransfer = libusb_alloc_transfer(0);
-  if (!mDisplayData.mpHeaderTransfer)
+  // Allocate buffers
+  mScreenBuffer.resize(PUSH_SCREEN_HEIGHT * PUSH_SCREEN_STRIDE);
+
+#if LIBUSB_API_VERSION >= 0x01000105
+  mDisplayData.mpUsbTransferBuffer =
+    libusb_dev_mem_alloc(mDisplayData.mpUsbDeviceHandle, PUSH_SCREEN_SIZE_BYTES);
+  mDisplayData.mUsbTransferBufferIsDevMem = mDisplayData.mpUsbTransferBuffer != nullptr;
+#endif
+
+  if (!mDisplayData.mpUsbTransferBuffer)
   {
-    throw std::bad_alloc();
+    mDisplayData.mUsbTransferBufferFallback.resize(PUSH_SCREEN_SIZE_BYTES);
+    mDisplayData.mpUsbTransferBuffer = mDisplayData.mUsbTransferBufferFallback.data();
   }
 
-  mDisplayData.mpDataTransfer = libusb_alloc_transfer(0);
-  if (!mDisplayData.mpDataTransfer)
+  // Allocate and set up USB transfers
+  mDisplayData.mpHeaderTransfer = libusb_alloc_transfer(0);
+  if (!mDisplayData.mpHeaderTransfer)
   {
-    libusb_free_transfer(mDisplayData.mpHeaderTransfer);
     throw std::bad_alloc();
   }
 
@@ -616,15 +786,33 @@ void PushHardware::initDisplay()
     &mDisplayData,
     1000);
 
-  libusb_fill_bulk_transfer(
-    mDisplayData.mpDataTransfer,
-    mDisplayData.mpUsbDeviceHandle,
-    0x1,
-    mDisplayData.mUsbTransferBuffer.data(),
-    mDisplayData.mUsbTransferBuffer.size(),
-    onTransferFinished,
-    &mDisplayData,
-    1000);
+  const auto chunkLines = mDisplayData.mChunkLines;
+  const auto numChunks = (PUSH_SCREEN_HEIGHT + chunkLines - 1) / chunkLines;
+  const auto lineBytes = PUSH_SCREEN_STRIDE * sizeof(uint16_t);
+
+  for (auto i = 0; i < numChunks; ++i)
+  {
+    const auto pTransfer = libusb_alloc_transfer(0);
+    if (!pTransfer)
+    {
+      throw std::bad_alloc();
+    }
+
+    mDisplayData.mDataTransfers.push_back(pTransfer);
+
+    const auto firstLine = i * chunkLines;
+    const auto endLine = std::min(firstLine + chunkLines, PUSH_SCREEN_HEIGHT);
+
+    libusb_fill_bulk_transfer(
+      pTransfer,
+      mDisplayData.mpUsbDeviceHandle,
+      0x1,
+      mDisplayData.mpUsbTransferBuffer + firstLine * lineBytes,
+      int((endLine - firstLine) * lineBytes),
+      onTransferFinished,
+      &mDisplayData,
+      1000);
+  }
 }
 
 
@@ -681,6 +869,45 @@ constexpr auto INPUT_MAPPING_TABLE = std::array{
 };
 
 
+// Doom key for each pad (by MIDI note number) and button (by CC number), 0 if the
+// control isn't mapped
+struct InputLookupTable
+{
+  std::array<uint8_t, 128> padKeys{};
+  std::array<uint8_t, 128> buttonKeys{};
+};
+
+constexpr auto INPUT_LOOKUP_TABLE = []() {
+  InputLookupTable result;
+
+  for (const auto& mapping : INPUT_MAPPING_TABLE)
+  {
+    if (const auto pPad = std::get_if<PadId>(&mapping.id))
+    {
+      result.padKeys[padNoteNumber(*pPad)] = mapping.doomKey;
+    }
+    else
+    {
+      result.buttonKeys[std::get<ButtonId>(mapping.id) & 0x7F] = mapping.doomKey;
+    }
+  }
+
+  return result;
+}();
+
+
+uint8_t lookUpDoomKey(const PadId& pad)
+{
+  return INPUT_LOOKUP_TABLE.padKeys[padNoteNumber(pad)];
+}
+
+
+uint8_t lookUpDoomKey(ButtonId button)
+{
+  return INPUT_LOOKUP_TABLE.buttonKeys[button & 0x7F];
+}
+
+
 int getCurrentAmmo(void)
 {
   ammotype_t ammoType = weaponinfo[players[consoleplayer].readyweapon].ammo;
@@ -759,37 +986,110 @@ AbleDoom::AbleDoom()
 
 std::optional<DoomInputEvent> AbleDoom::fetchEvent()
 {
-  if (mEventQueue.empty())
+  if (mEventQueueHead == mEventQueueTail)
+  {
+    // Queue is drained, see if Push has anything new for us. This invokes onInput()
+    // for each event.
+    mHardware.pollInput();
+  }
+
+  if (mEventQueueHead == mEventQueueTail)
   {
     return {};
   }
 
-  const auto event = mEventQueue.front();
-  mEventQueue.pop_front();
-  return event;
+  return mEventQueue[mEventQueueTail++ % mEventQueue.size()];
+}
+
+
+AbleDoom::~AbleDoom()
+{
+  if (mFrameCount > 0)
+  {
+    printf(
+      "AbleDoom: status bar unchanged in %d of %d frames (%.1f%%)\n",
+      mStatusBarUnchangedCount,
+      mFrameCount,
+      100.0 * mStatusBarUnchangedCount / mFrameCount);
+  }
+
+  if (mEventQueueOverflows > 0)
+  {
+    printf(
+      "AbleDoom: input queue overflowed %d times, key presses were dropped\n",
+      mEventQueueOverflows);
+  }
 }
 
 
 void AbleDoom::drawFrame(const uint32_t* pFrameBuffer)
 {
+  I_PerfBegin(PERF_DRAWFRAME);
+
   // The Push display is only 160 pixels high, so it doesn't fit the entire Doom
   // framebuffer (200 px). To work around that, we display the bottom 40 rows of pixels
   // on the right side of the screen, next to the main framebuffer image.
   const auto mainCenter = (PUSH_SCREEN_WIDTH - DOOMGENERIC_RESX) / 2;
 
-  mHardware.copyToScreen(
-    pFrameBuffer, 0, 0, DOOMGENERIC_RESX, PUSH_SCREEN_HEIGHT, mainCenter, 0);
-  mHardware.copyToScreen(
-    pFrameBuffer,
-    0,
-    PUSH_SCREEN_HEIGHT,
-    DOOMGENERIC_RESX,
-    DOOMGENERIC_RESY - PUSH_SCREEN_HEIGHT,
-    mainCenter + DOOMGENERIC_RESX,
-    0);
+  // Only copy the rows that changed since the last frame. The rest of the Push screen
+  // buffer still holds them from before.
+  auto statusBarChanged = false;
+
+  for (auto y = 0; y < DOOMGENERIC_RESY;)
+  {
+    if (!DG_DirtyRows[y])
+    {
+      ++y;
+      continue;
+    }
+
+    // Find the end of this run of changed rows. Runs can't cross over from the main
+    // image to the bottom part.
+    const auto areaEnd = y < PUSH_SCREEN_HEIGHT ? PUSH_SCREEN_HEIGHT : DOOMGENERIC_RESY;
+    auto endY = y + 1;
+
+    while (endY < areaEnd && DG_DirtyRows[endY])
+    {
+      ++endY;
+    }
+
+    if (y < PUSH_SCREEN_HEIGHT)
+    {
+      mHardware.copyToScreen(
+        pFrameBuffer, 0, y, DOOMGENERIC_RESX, endY - y, mainCenter, y);
+    }
+    else
+    {
+      mHardware.copyToScreen(
+        pFrameBuffer,
+        0,
+        y,
+        DOOMGENERIC_RESX,
+        endY - y,
+        mainCenter + DOOMGENERIC_RESX,
+        y - PUSH_SCREEN_HEIGHT);
+    }
+
+    if (endY > DOOMGENERIC_RESY - ST_HEIGHT)
+    {
+      statusBarChanged = true;
+    }
+
+    y = endY;
+  }
+
+  ++mFrameCount;
+
+  if (!statusBarChanged)
+  {
+    ++mStatusBarUnchangedCount;
+  }
+
   mHardware.submitScreen();
 
   updateHealthArmorDisplay();
+
+  I_PerfEnd(PERF_DRAWFRAME, DOOMGENERIC_RESX * DOOMGENERIC_RESY);
 }
 
 
@@ -801,25 +1101,65 @@ void AbleDoom::onInput(const PushInputEvent& input)
   }
 
   // Map Push button to Doom key
-  const auto iMapping = std::find_if(
-    std::begin(INPUT_MAPPING_TABLE),
-    std::end(INPUT_MAPPING_TABLE),
-    [&input](const InputMapping& mapping) { return mapping.id == input.id; });
+  auto key = std::visit([](const auto& id) { return lookUpDoomKey(id); }, input.id);
 
-  if (iMapping != std::end(INPUT_MAPPING_TABLE))
+  if (key != 0)
   {
-    auto key = iMapping->doomKey;
-
     // Do quick load on Shift + Save. The input mapping system here doesn't allow for
     // button combinations, so we handle this as a special case (KEY_F6 is the quick
     // save key, KEY_F9 is quick load).
-    if (iMapping->doomKey == KEY_F6 && mShiftHeld)
+    if (key == KEY_F6 && mShiftHeld)
     {
       key = KEY_F9;
     }
 
-    mEventQueue.push_back(DoomInputEvent{key, input.pressed});
+    if (
+      mEventQueueHead - mEventQueueTail < mEventQueue.size()
+      || makeRoomForEvent(input.pressed))
+    {
+      mEventQueue[mEventQueueHead++ % mEventQueue.size()] =
+        DoomInputEvent{key, input.pressed};
+    }
+  }
+}
+
+
+// Called when the event queue is full. It's drained every tic, so this takes an absurd
+// amount of button mashing. Presses can be dropped, but a lost release would leave the
+// key held in the game, so a release pushes the oldest queued press out instead.
+// Returns false if the new event should be dropped.
+bool AbleDoom::makeRoomForEvent(bool pressed)
+{
+  ++mEventQueueOverflows;
+
+  if (pressed)
+  {
+    return false;
   }
+
+  const auto size = mEventQueue.size();
+
+  for (auto i = mEventQueueTail; i != mEventQueueHead; ++i)
+  {
+    if (mEventQueue[i % size].pressed)
+    {
+      // Close the gap by moving the older events along by one
+      for (auto j = i; j != mEventQueueTail; --j)
+      {
+        mEventQueue[j % size] = mEventQueue[(j - 1) % size];
+      }
+
+      ++mEventQueueTail;
+      return true;
+    }
+  }
+
+  // Only releases are queued. Each one must be for a different control (a second
+  // release would need a press in between), and there are fewer mapped controls than
+  // queue entries, so this can't happen. Keep the newest events if it does.
+  static_assert(INPUT_MAPPING_TABLE.size() < std::tuple_size_v<decltype(mEventQueue)>);
+  ++mEventQueueTail;
+  return true;
 }
 
 
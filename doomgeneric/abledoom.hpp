@@ -17,10 +17,12 @@
 
 #include "RtMidi.h"
 
+#include <alsa/asoundlib.h>
 #include <libusb-1.0/libusb.h>
 
+#include <array>
+#include <chrono>
 #include <cstdint>
-#include <deque>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -31,6 +33,10 @@ constexpr auto PUSH_SCREEN_WIDTH = 960;
 constexpr auto PUSH_SCREEN_HEIGHT = 160;
 constexpr auto PUSH_SCREEN_STRIDE = 1024;
 
+// Default number of display lines sent per USB transfer (16 KB), can be changed with
+// the -pushchunklines command line parameter
+constexpr auto PUSH_DISPLAY_CHUNK_LINES = 8;
+
 
 // For queuing up Doom input events (fake keypresses)
 struct DoomInputEvent
@@ -78,14 +84,26 @@ public:
     int mDisplayError = 0;
 
     libusb_transfer* mpHeaderTransfer = nullptr;
-    libusb_transfer* mpDataTransfer = nullptr;
 
-    std::vector<uint8_t> mUsbTransferBuffer;
-    bool mTransferInProgress = false;
+    // The frame data is split into chunks of mChunkLines display lines, each sent
+    // by its own transfer, so that the first chunks can be on the wire while the
+    // later ones are still being prepared
+    std::vector<libusb_transfer*> mDataTransfers;
+    int mChunkLines = PUSH_DISPLAY_CHUNK_LINES;
+
+    // Encoded frame data for all chunks. Allocated via libusb_dev_mem_alloc() where
+    // the platform supports it (saves the kernel a copy), otherwise this points into
+    // mUsbTransferBufferFallback.
+    uint8_t* mpUsbTransferBuffer = nullptr;
+    bool mUsbTransferBufferIsDevMem = false;
+    std::vector<uint8_t> mUsbTransferBufferFallback;
+
+    // Number of submitted transfers that haven't finished yet
+    int mTransfersInFlight = 0;
   };
 
   // Callback that will be invoked for every incoming Push event
-  // (button or pad press/release)
+  // (button or pad press/release), from within pollInput()
   using InputCallback = std::function<void(PushInputEvent)>;
 
   explicit PushHardware(InputCallback inputCallback);
@@ -103,12 +121,17 @@ public:
   void setLight(const PadId& pad, int value);
   void setLight(ButtonId button, int value);
 
+  // Read all pending MIDI input from Push and pass it on to the input callback.
+  // Doesn't block.
+  void pollInput();
+
   // Turn off all LEDs
   void resetLEDs();
 
   // Copy a rectangular portion of the specified source buffer to the specified position
-  // on the Push display. This function only copies into a buffer, call submitScreen()
-  // to actually send the image to the Push display.
+  // on the Push display. The copy is deferred until submitScreen() (which sends the
+  // image to the Push display), so that it can be done chunk by chunk while earlier
+  // chunks are being transferred. `srcBuffer` must stay valid until then.
   void copyToScreen(
     const uint32_t* srcBuffer,
     int srcX,
@@ -124,17 +147,28 @@ public:
   void copyToScreen(const uint16_t* data);
 
   // Submit current frame to Push display (returns immediately, the transmission
-  // happens asynchronously)
+  // happens asynchronously). Does nothing if the frame hasn't changed since the last
+  // one sent, apart from occasionally resending it to keep the display awake.
   void submitScreen();
 
 private:
-  static void onMessage(double, std::vector<unsigned char>* pMessage, void* pSelf);
+  struct PendingCopy
+  {
+    const uint32_t* srcBuffer;
+    int srcX, srcY;
+    int width, height;
+    int destX, destY;
+  };
 
   void initDisplay();
 
-  // MIDI I/O
+  // Carry out the parts of pending copyToScreen() calls which touch the given range
+  // of display lines
+  void applyPendingCopies(int firstLine, int endLine);
+
+  // MIDI I/O. Input is read straight from the ALSA sequencer, output goes via RtMidi
   InputCallback mInputCallback;
-  std::unique_ptr<RtMidiIn> mpMidiIn;
+  snd_seq_t* mpMidiIn = nullptr;
   std::unique_ptr<RtMidiOut> mpMidiOut;
 
   // Buffer for sending MIDI messages to Push. To avoid frequent allocations, keep
@@ -144,6 +178,18 @@ private:
   // Current frame buffer (both copyToScreen() overloads write into this)
   std::vector<uint16_t> mScreenBuffer;
 
+  // Copies requested since the last submitScreen()
+  std::array<PendingCopy, 8> mPendingCopies;
+  size_t mNumPendingCopies = 0;
+
+  // Set when mScreenBuffer has changed since the last frame sent to the display
+  bool mScreenChanged = true;
+  std::chrono::steady_clock::time_point mLastSubmitTime;
+
+  // Statistics, printed on exit
+  int mFramesSent = 0;
+  int mFramesUnchanged = 0;
+
   // Display I/O
   DisplayData mDisplayData;
 };
@@ -155,6 +201,7 @@ class AbleDoom
 {
 public:
   AbleDoom();
+  ~AbleDoom();
 
   // Fetch pending input event, if any
   std::optional<DoomInputEvent> fetchEvent();
@@ -165,12 +212,23 @@ public:
 
 private:
   void onInput(const PushInputEvent& event);
+  bool makeRoomForEvent(bool pressed);
   void updateHealthArmorDisplay();
 
-  std::deque<DoomInputEvent> mEventQueue;
+  // Input events waiting to be fetched. This is a fixed size ring buffer, so that
+  // queuing events doesn't need to allocate
+  std::array<DoomInputEvent, 64> mEventQueue;
+  unsigned int mEventQueueHead = 0;
+  unsigned int mEventQueueTail = 0;
+
   PushHardware mHardware;
   int mLastHealthButtonCount;
   int mLastArmorButtonCount;
   int mLastAmmoButtonCount;
   bool mShiftHeld = false;
+
+  // Statistics, printed on exit
+  int mFrameCount = 0;
+  int mStatusBarUnchangedCount = 0;
+  int mEventQueueOverflows = 0;
 };
@@ -0,0 +1,60 @@
+/* AbleDOOM - Doom on Ableton Push 3 Standalone!
+ *
+ * Copyright (C) 2024 Nikolai Wuttke-Hohendorf
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Pixel conversion kernels for the Push display. These don't depend on the
+// hardware, so that they can also be used by the benchmarks in doombench.cpp.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+// Pack color into the 16-bit format expected by the Push display
+inline uint16_t toBGR565(uint32_t color)
+{
+  const auto r = (color & 0x00FF0000) >> 16;
+  const auto g = (color & 0x0000FF00) >> 8;
+  const auto b = (color & 0x000000FF);
+
+  return ((b & 0xF8) << 8) | ((g & 0xFC) << 3) | (r >> 3);
+}
+
+
+// Convert `count` pixels from the Doom framebuffer into Push pixel format
+inline void convertToBGR565(uint16_t* pDest, const uint32_t* pSrc, int count)
+{
+  for (auto x = 0; x < count; ++x)
+  {
+    pDest[x] = toBGR565(pSrc[x]);
+  }
+}
+
+
+// Copy display data into a USB transfer buffer, applying the signal shaping XOR
+// pattern as we go. `sizeBytes` must be a multiple of 4.
+// See
+// https://github.com/Ableton/push-interface/blob/main/doc/AbletonPush2MIDIDisplayInterface.asc#xoring-pixel-data
+inline void encodeDisplayData(uint8_t* pDest, const uint16_t* pSrc, size_t sizeBytes)
+{
+  for (auto i = 0u; i < sizeBytes / sizeof(uint32_t); ++i)
+  {
+    uint32_t value;
+    std::memcpy(&value, pSrc + i * 2, sizeof(value));
+    value ^= 0xffe7f3e7;
+    std::memcpy(pDest + i * sizeof(value), &value, sizeof(value));
+  }
+}
@@ -18,6 +18,7 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "deh_main.h"
 
@@ -28,6 +29,7 @@
 #include "p_local.h"
 #include "w_wad.h"
 
+#include "m_bbox.h"
 #include "m_cheat.h"
 #include "m_controls.h"
 #include "m_misc.h"
@@ -105,6 +107,10 @@
 #define CXMTOF(x)  (f_x + MTOF((x)-m_x))
 #define CYMTOF(y)  (f_y + (f_h - MTOF((y)-m_y)))
 
+// distance beyond the window edge past which a thing's
+// triangle cannot reach into the window
+#define THINGCULLDIST	(17<<FRACBITS)
+
 // the following is crap
 #define LINE_NEVERSEE ML_DONTDRAW
 
@@ -1116,6 +1122,217 @@ void AM_drawGrid(int color)
 
 }
 
+//
+// Spatial index of the level's linedefs, used to find the lines that
+// may intersect the automap window without clipping every line in
+// the level each frame.
+//
+// The level is divided into a grid of square cells; each cell lists,
+// in ascending order, the lines whose bounding box overlaps it.
+// The index lives in a single PU_LEVEL block, so it is thrown away
+// (and am_lineindex cleared) whenever a new level is loaded.
+//
+#define AM_CELLSHIFT	7	// 128 map units, same as a blockmap block
+
+static int*	am_lineindex;	// PU_LEVEL block holding everything below
+static int*	am_celloffsets;	// per cell (plus one), start in am_celllines
+static int*	am_celllines;	// line numbers, grouped by cell
+static int*	am_linestamp;	// per line, last frame it was gathered
+static int*	am_visiblelines; // lines gathered for the current frame
+static int	am_cellorgx;
+static int	am_cellorgy;	// origin of the grid (map units)
+static int	am_cellwidth;
+static int	am_cellheight;	// size of the grid (cells)
+static int	am_stamp;
+
+static void AM_lineCellBox(line_t *li, int *box)
+{
+    box[BOXLEFT] = ((li->bbox[BOXLEFT] >> FRACBITS) - am_cellorgx)
+                 >> AM_CELLSHIFT;
+    box[BOXRIGHT] = ((li->bbox[BOXRIGHT] >> FRACBITS) - am_cellorgx)
+                  >> AM_CELLSHIFT;
+    box[BOXBOTTOM] = ((li->bbox[BOXBOTTOM] >> FRACBITS) - am_cellorgy)
+                   >> AM_CELLSHIFT;
+    box[BOXTOP] = ((li->bbox[BOXTOP] >> FRACBITS) - am_cellorgy)
+                >> AM_CELLSHIFT;
+}
+
+//
+// Builds the line index for the current level.
+//
+static void AM_buildLineIndex(void)
+{
+    int		i;
+    int		x;
+    int		y;
+    int		numcells;
+    int		numrefs;
+    int		box[4];
+    fixed_t	bbox[4];
+    int*	fill;
+
+    M_ClearBox(bbox);
+
+    for (i=0;i<numlines;i++)
+    {
+	M_AddToBox(bbox, lines[i].bbox[BOXLEFT], lines[i].bbox[BOXBOTTOM]);
+	M_AddToBox(bbox, lines[i].bbox[BOXRIGHT], lines[i].bbox[BOXTOP]);
+    }
+
+    am_cellorgx = bbox[BOXLEFT] >> FRACBITS;
+    am_cellorgy = bbox[BOXBOTTOM] >> FRACBITS;
+    am_cellwidth = (((bbox[BOXRIGHT] >> FRACBITS) - am_cellorgx)
+                    >> AM_CELLSHIFT) + 1;
+    am_cellheight = (((bbox[BOXTOP] >> FRACBITS) - am_cellorgy)
+                     >> AM_CELLSHIFT) + 1;
+    numcells = am_cellwidth * am_cellheight;
+
+    // First pass: count the lines in each cell.
+
+    fill = Z_Malloc(numcells * sizeof(int), PU_STATIC, NULL);
+    memset(fill, 0, numcells * sizeof(int));
+    numrefs = 0;
+
+    for (i=0;i<numlines;i++)
+    {
+	AM_lineCellBox(&lines[i], box);
+
+	for (y=box[BOXBOTTOM];y<=box[BOXTOP];y++)
+	{
+	    for (x=box[BOXLEFT];x<=box[BOXRIGHT];x++)
+	    {
+		fill[y * am_cellwidth + x]++;
+		numrefs++;
+	    }
+	}
+    }
+
+    Z_Malloc((numcells + 1 + numrefs + numlines * 2) * sizeof(int),
+             PU_LEVEL, &am_lineindex);
+
+    am_celloffsets = am_lineindex;
+    am_celllines = am_celloffsets + numcells + 1;
+    am_linestamp = am_celllines + numrefs;
+    am_visiblelines = am_linestamp + numlines;
+
+    memset(am_linestamp, 0, numlines * sizeof(int));
+    am_stamp = 0;
+
+    am_celloffsets[0] = 0;
+
+    for (i=0;i<numcells;i++)
+    {
+	am_celloffsets[i+1] = am_celloffsets[i] + fill[i];
+	fill[i] = am_celloffsets[i];
+    }
+
+    // Second pass: fill in the line numbers. Lines are visited in
+    // ascending order, so every cell's list ends up sorted.
+
+    for (i=0;i<numlines;i++)
+    {
+	AM_lineCellBox(&lines[i], box);
+
+	for (y=box[BOXBOTTOM];y<=box[BOXTOP];y++)
+	    for (x=box[BOXLEFT];x<=box[BOXRIGHT];x++)
+		am_celllines[fill[y * am_cellwidth + x]++] = i;
+    }
+
+    Z_Free(fill);
+}
+
+static int AM_compareLines(const void *a, const void *b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+//
+// Gathers the lines whose bounding box may overlap the automap
+// window into am_visiblelines. They are returned in ascending order,
+// so that lines get drawn in exactly the same order as when walking
+// the whole line list; any line not gathered here would have been
+// trivially rejected by AM_clipMline() anyway.
+//
+static int AM_gatherLines(void)
+{
+    int		x;
+    int		y;
+    int		i;
+    int		cell;
+    int		xl, xh, yl, yh;
+    int		count;
+
+    if (am_lineindex == NULL)
+	AM_buildLineIndex();
+
+    xl = ((m_x >> FRACBITS) - am_cellorgx) >> AM_CELLSHIFT;
+    xh = ((m_x2 >> FRACBITS) - am_cellorgx) >> AM_CELLSHIFT;
+    yl = ((m_y >> FRACBITS) - am_cellorgy) >> AM_CELLSHIFT;
+    yh = ((m_y2 >> FRACBITS) - am_cellorgy) >> AM_CELLSHIFT;
+
+    if (xl < 0)
+	xl = 0;
+    if (yl < 0)
+	yl = 0;
+    if (xh >= am_cellwidth)
+	xh = am_cellwidth - 1;
+    if (yh >= am_cellheight)
+	yh = am_cellheight - 1;
+
+    // The window covers the whole grid, so every line is in.
+
+    if (xl == 0 && yl == 0
+     && xh == am_cellwidth - 1 && yh == am_cellheight - 1)
+    {
+	for (i=0;i<numlines;i++)
+	    am_visiblelines[i] = i;
+
+	return numlines;
+    }
+
+    am_stamp++;
+    count = 0;
+
+    for (y=yl;y<=yh;y++)
+    {
+	for (x=xl;x<=xh;x++)
+	{
+	    cell = y * am_cellwidth + x;
+
+	    for (i=am_celloffsets[cell];i<am_celloffsets[cell+1];i++)
+	    {
+		if (am_linestamp[am_celllines[i]] != am_stamp)
+		{
+		    am_linestamp[am_celllines[i]] = am_stamp;
+		    am_visiblelines[count++] = am_celllines[i];
+		}
+	    }
+	}
+    }
+
+    // Gathering from more than one cell breaks the ordering. Once a
+    // good part of the level has been gathered, picking the lines out
+    // by their stamps, in line order, is cheaper than sorting them.
+
+    if (xl < xh || yl < yh)
+    {
+	if (count > numlines / 8)
+	{
+	    count = 0;
+
+	    for (i=0;i<numlines;i++)
+		if (am_linestamp[i] == am_stamp)
+		    am_visiblelines[count++] = i;
+	}
+	else
+	{
+	    qsort(am_visiblelines, count, sizeof(int), AM_compareLines);
+	}
+    }
+
+    return count;
+}
+
 //
 // Determines visible lines, draws them.
 // This is LineDef based, not LineSeg based.
@@ -1123,10 +1340,15 @@ void AM_drawGrid(int color)
 void AM_drawWalls(void)
 {
     int i;
+    int n;
+    int numvisible;
     static mline_t l;
 
-    for (i=0;i<numlines;i++)
+    numvisible = AM_gatherLines();
+
+    for (n=0;n<numvisible;n++)
     {
+	i = am_visiblelines[n];
 	l.a.x = lines[i].v1->x;
 	l.a.y = lines[i].v1->y;
 	l.b.x = lines[i].v2->x;
@@ -1300,6 +1522,15 @@ AM_drawThings
 	t = sectors[i].thinglist;
 	while (t)
 	{
+	    // The triangle is at most 16 units across, so a thing this
+	    // far outside the window would be clipped away entirely.
+	    if (t->x < m_x - THINGCULLDIST || t->x > m_x2 + THINGCULLDIST
+	     || t->y < m_y - THINGCULLDIST || t->y > m_y2 + THINGCULLDIST)
+	    {
+		t = t->snext;
+		continue;
+	    }
+
 	    AM_drawLineCharacter
 		(thintriangle_guy, arrlen(thintriangle_guy),
 		 16<<FRACBITS, t->angle, colors+lightlev, t->x, t->y);
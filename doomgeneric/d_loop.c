@@ -307,7 +307,7 @@ void D_StartGameLoop(void)
     lasttime = GetAdjustedTime() / ticdup;
 }
 
-#if ORIGCODE
+#ifdef FEATURE_MULTIPLAYER
 //
 // Block until the game start message is received from the server.
 //
@@ -340,7 +340,7 @@ static void BlockUntilStart(net_gamesettings_t *settings,
 void D_StartNetGame(net_gamesettings_t *settings,
                     netgame_startup_callback_t callback)
 {
-#if ORIGCODE
+#ifdef FEATURE_MULTIPLAYER
     int i;
 
     offsetms = 0;
@@ -389,7 +389,8 @@ void D_StartNetGame(net_gamesettings_t *settings,
     // @arg <n>
     //
     // Reduce the resolution of the game by a factor of n, reducing
-    // the amount of network bandwidth needed.
+    // the amount of network bandwidth needed.  By default, the server
+    // picks a value based on the round trip times to the players.
     //
 
     i = M_CheckParmWithArgs("-dup", 1);
@@ -397,7 +398,7 @@ void D_StartNetGame(net_gamesettings_t *settings,
     if (i > 0)
         settings->ticdup = atoi(myargv[i+1]);
     else
-        settings->ticdup = 1;
+        settings->ticdup = 0;
 
     if (net_client_connected)
     {
@@ -426,6 +427,14 @@ void D_StartNetGame(net_gamesettings_t *settings,
         local_playeringame[i] = i < settings->num_players;
     }
 
+    // A ticdup of 0 asks the server to choose; without one, or if
+    // the server left it unset, run at the full tic rate.
+
+    if (settings->ticdup < 1)
+    {
+        settings->ticdup = 1;
+    }
+
     // Copy settings to global variables.
 
     ticdup = settings->ticdup;
@@ -68,6 +68,11 @@ void D_StartGameLoop(void);
 
 boolean D_InitNetGame(net_connect_data_t *connect_data);
 
+// Invoked by the network client when a full set of ticcmds for the
+// next tic has arrived; NULL arguments mean the connection was lost.
+
+void D_ReceiveTic(ticcmd_t *ticcmds, boolean *players_mask);
+
 // Start game with specified settings. The structure will be updated
 // with the actual settings for the game.
 
@@ -54,6 +54,10 @@
 
 #include "i_endoom.h"
 #include "i_joystick.h"
+#include "i_perf.h"
+#ifdef ALLOCTRACK
+#include "i_alloctrack.h"
+#endif
 #include "i_system.h"
 #include "i_timer.h"
 #include "i_video.h"
@@ -402,6 +406,144 @@ boolean D_GrabMouseCallback(void)
     return (gamestate == GS_LEVEL) && !demoplayback && !advancedemo;
 }
 
+//
+// STARTUP TIMELINE
+//
+
+#define MAX_STARTUP_MARKS 32
+
+typedef struct
+{
+    char *name;
+    uint64_t time;
+} startupmark_t;
+
+static startupmark_t startupmarks[MAX_STARTUP_MARKS];
+static int numstartupmarks = 0;
+static boolean firstframedrawn = false;
+static boolean startupreported = false;
+
+//
+// Initialization that isn't needed for the title screen and the menus.
+// With -faststart, this runs one step per frame once the title screen
+// is up, and is finished by D_FinishStartup before the first level
+// loads.  The zone allocator and the WAD cache aren't thread safe, so
+// it has to run on the main thread, between frames.
+//
+
+typedef struct
+{
+    char *name;
+    char *description;
+    void (*func)(void);
+} startupstep_t;
+
+static startupstep_t startupsteps[] =
+{
+    { "R_InitTextures",   "Init textures",             R_InitTextures },
+    { "R_InitFlats",      "Init flats",                R_InitFlats },
+    { "R_InitSpriteLumps", "Init sprite lumps",        R_InitSpriteLumps },
+    { "P_Init",           "Init Playloop state",       P_Init },
+    { "S_PrecacheSounds", "Precache sound effects",    S_PrecacheSounds },
+    { "ST_Init",          "Init status bar",           ST_Init },
+};
+
+static unsigned int nextstartupstep = 0;
+
+static void PrintStartupTimeline(void)
+{
+    uint64_t start, last;
+    int i;
+
+    start = last = startupmarks[0].time;
+
+    printf("Startup timeline (ms since start, ms for step):\n");
+
+    for (i = 1; i < numstartupmarks; ++i)
+    {
+        printf("  %8.1f  %8.1f  %s\n",
+               (startupmarks[i].time - start) / 1000000.0,
+               (startupmarks[i].time - last) / 1000000.0,
+               startupmarks[i].name);
+
+        last = startupmarks[i].time;
+    }
+}
+
+//
+// D_StartupMark
+// Record that a startup step has just finished.  The timeline is
+// printed once the first frame is shown and all steps are done.
+//
+
+void D_StartupMark(char *name)
+{
+    if (numstartupmarks < MAX_STARTUP_MARKS)
+    {
+        startupmarks[numstartupmarks].name = name;
+        startupmarks[numstartupmarks].time = I_GetTimeNS();
+        ++numstartupmarks;
+    }
+
+    if (!startupreported && firstframedrawn
+     && nextstartupstep == arrlen(startupsteps))
+    {
+        PrintStartupTimeline();
+        startupreported = true;
+    }
+}
+
+static void D_RunStartupStep(void)
+{
+    startupstep_t *step;
+
+    step = &startupsteps[nextstartupstep];
+    ++nextstartupstep;
+
+    DEH_printf("%s: %s.\n", step->name, step->description);
+    step->func();
+    D_StartupMark(step->name);
+}
+
+//
+// D_FinishStartup
+// Run any startup steps that are still pending.  Must be called before
+// starting a level.
+//
+
+void D_FinishStartup(void)
+{
+    while (nextstartupstep < arrlen(startupsteps))
+    {
+        D_RunStartupStep();
+    }
+}
+
+//
+// D_EnergyState
+// What the time and energy of this frame go to, for -energy.
+//
+
+static energystate_t D_EnergyState(void)
+{
+    if (paused)
+    {
+        return ENERGY_PAUSED;
+    }
+    else if (menuactive)
+    {
+        return ENERGY_MENU;
+    }
+    else if (gamestate == GS_LEVEL)
+    {
+        return ENERGY_LEVEL;
+    }
+    else
+    {
+        return ENERGY_OTHER;
+    }
+}
+
 void doomgeneric_Tick()
 {
     // frame syncronous IO operations
@@ -415,7 +557,28 @@ void doomgeneric_Tick()
     if (screenvisible)
     {
         D_Display ();
+
+        if (!firstframedrawn)
+        {
+            firstframedrawn = true;
+            D_StartupMark("first frame");
+        }
     }
+
+    // Continue deferred startup, one step per frame
+    if (nextstartupstep < arrlen(startupsteps))
+    {
+        D_RunStartupStep();
+    }
+
+    if (energycounting)
+    {
+        I_EnergySample(D_EnergyState(), gametic, screenvisible && !nodrawers);
+    }
+
+#ifdef ALLOCTRACK
+    I_AllocFrame();
+#endif
 }
 
 //
@@ -444,6 +607,7 @@ void D_DoomLoop (void)
     I_SetGrabMouseCallback(D_GrabMouseCallback);
     I_InitGraphics();
     I_EnableLoadingDisk();
+    D_StartupMark("I_InitGraphics");
 
     V_RestoreBuffer();
     R_ExecuteSetViewSize();
@@ -1607,12 +1771,20 @@ void D_DoomMain (void)
         I_PrintDivider();
     }
 
+    D_StartupMark("W_Init");
+
     DEH_printf("I_Init: Setting up machine state.\n");
     I_CheckIsScreensaver();
     I_InitTimer();
+    I_InitPerfCounters();
+    I_InitEnergy();
+#ifdef ALLOCTRACK
+    I_InitAllocTracking();
+#endif
     I_InitJoystick();
     I_InitSound(true);
     I_InitMusic();
+    D_StartupMark("I_Init");
 
 #ifdef FEATURE_MULTIPLAYER
     printf ("NET_Init: Init network subsystem.\n");
@@ -1759,26 +1931,42 @@ void D_DoomMain (void)
 
     DEH_printf("M_Init: Init miscellaneous info.\n");
     M_Init ();
+    D_StartupMark("M_Init");
 
-    DEH_printf("R_Init: Init DOOM refresh daemon - ");
-    R_Init ();
+    // The texture, flat and sprite tables are set up with the other
+    // startup steps below.
 
-    DEH_printf("\nP_Init: Init Playloop state.\n");
-    P_Init ();
+    DEH_printf("R_Init: Init DOOM refresh daemon - ");
+    R_InitColormaps ();
+    R_InitView ();
+    DEH_printf("\n");
+    D_StartupMark("R_InitView");
 
     DEH_printf("S_Init: Setting up sound.\n");
     S_Init (sfxVolume * 8, musicVolume * 8);
+    D_StartupMark("S_Init");
 
     DEH_printf("D_CheckNetGame: Checking network game status.\n");
     D_CheckNetGame ();
+    D_StartupMark("D_CheckNetGame");
 
     PrintGameVersion();
 
     DEH_printf("HU_Init: Setting up heads up display.\n");
     HU_Init ();
+    D_StartupMark("HU_Init");
 
-    DEH_printf("ST_Init: Init status bar.\n");
-    ST_Init ();
+    //!
+    // @category obscure
+    //
+    // Show the title screen as soon as possible, and finish starting
+    // up (textures, sprites, status bar...) while it is shown.
+    //
+
+    if (!M_CheckParm("-faststart"))
+    {
+        D_FinishStartup();
+    }
 
     // If Doom II without a MAP01 lump, this is a store demo.
     // Moved this here so that MAP01 isn't constantly looked up
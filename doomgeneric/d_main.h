@@ -38,6 +38,12 @@ void D_PageDrawer (void);
 void D_AdvanceDemo (void);
 void D_DoAdvanceDemo (void);
 void D_StartTitle (void);
+
+//
+// STARTUP
+//
+void D_StartupMark (char *name);
+void D_FinishStartup (void);
  
 //
 // GLOBAL VARIABLES
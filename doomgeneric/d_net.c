@@ -18,6 +18,7 @@
 //
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "doomfeatures.h"
 
@@ -205,6 +206,8 @@ static void InitConnectData(net_connect_data_t *connect_data)
 
 #if ORIGCODE
     DEH_Checksum(connect_data->deh_sha1sum);
+#else
+    memset(connect_data->deh_sha1sum, 0, sizeof(sha1_digest_t));
 #endif
 
     // Are we playing with the Freedoom IWAD?
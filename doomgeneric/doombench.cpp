@@ -0,0 +1,696 @@
+/* AbleDOOM - Doom on Ableton Push 3 Standalone!
+ *
+ * Copyright (C) 2024 Nikolai Wuttke-Hohendorf
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Micro-benchmarks for the renderer, pixel conversion and encoding kernels.
+//
+// Each kernel is timed in isolation, on synthetic data and optionally on data from
+// a WAD file, and reported as nanoseconds and cycles per operation, and bytes
+// per cycle. Cycles are TSC ticks (x86 only), i.e. at the nominal clock
+// rate.
+//
+// Usage: doombench [-iwad <file>] [-only <name>] [-samples <n>] [-sampletime <ms>]
+//
+// Engine parameters are passed through, so variants selected by command line
+// switches (like -nopatchcache) can be compared directly. To compare two
+// implementations of a kernel, add the variant to makeKernels() under its own name,
+// or build two binaries with different OPTFLAGS and OBJDIR.
+
+#include "abledoom.hpp"
+#include "abledoom_pixels.hpp"
+
+#include "doomgeneric.h"
+
+extern "C"
+{
+#include "i_swap.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "memio.h"
+#include "mus2mid.h"
+#include "r_data.h"
+#include "r_draw.h"
+#include "r_main.h"
+#include "r_state.h"
+#include "v_patch.h"
+#include "v_video.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+void cmap_to_fb(uint8_t* out, uint8_t* in, int in_pixels);
+}
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+//
+// Platform layer stubs, the engine is only initialized as far as the kernels need
+//
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void DG_Init() {}
+
+void DG_DrawFrame() {}
+
+void DG_SleepMs(uint32_t) {}
+
+uint32_t DG_GetTicksMs()
+{
+  return 0;
+}
+
+int DG_GetKey(int*, unsigned char*)
+{
+  return 0;
+}
+
+void DG_SetWindowTitle(const char*) {}
+
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////////////////////
+//
+// Timing
+//
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t nowNs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+  return uint64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+
+uint64_t readCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+
+struct Kernel
+{
+  std::string name;
+
+  // Size of the destination area per operation, or of the input for kernels
+  // without one (0 if not meaningful)
+  size_t bytesPerOp;
+
+  // Runs the given number of operations
+  std::function<void(int)> run;
+};
+
+
+struct Result
+{
+  double nsPerOp;
+  double cyclesPerOp;
+};
+
+
+// Result of the fastest sample, each sample running long enough to time reliably
+Result measure(const Kernel& kernel, int samples, uint64_t sampleNs)
+{
+  auto iterations = 1;
+
+  for (;;)
+  {
+    const auto start = nowNs();
+    kernel.run(iterations);
+
+    if (nowNs() - start >= sampleNs || iterations >= (1 << 30))
+    {
+      break;
+    }
+
+    iterations *= 2;
+  }
+
+  auto result = Result{
+    std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+
+  for (auto i = 0; i < samples; ++i)
+  {
+    const auto startNs = nowNs();
+    const auto startCycles = readCycles();
+
+    kernel.run(iterations);
+
+    const auto cycles = readCycles() - startCycles;
+    const auto ns = nowNs() - startNs;
+
+    result.nsPerOp = std::min(result.nsPerOp, double(ns) / iterations);
+    result.cyclesPerOp = std::min(result.cyclesPerOp, double(cycles) / iterations);
+  }
+
+  return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+//
+// Input data
+//
+//////////////////////////////////////////////////////////////////////////////////////////
+
+struct BenchData
+{
+  std::string name;
+
+  lighttable_t* pColormaps = nullptr;
+
+  byte* pColumn = nullptr;
+  int columnLength = 0;
+
+  byte* pSpriteColumn = nullptr;
+  int spriteColumnLength = 0;
+
+  byte* pFlat = nullptr;
+
+  patch_t* pPatch = nullptr;
+  int patchX = 0;
+  int patchY = 0;
+
+  std::vector<byte> mus;
+
+  std::vector<const char*> lumpNames;
+};
+
+
+// Keeps synthetic data alive for the whole run
+std::vector<std::vector<byte>> syntheticStorage;
+
+
+byte* makeSyntheticBuffer(size_t size)
+{
+  auto& buffer = syntheticStorage.emplace_back(size);
+
+  for (auto& value : buffer)
+  {
+    value = byte(rand());
+  }
+
+  return buffer.data();
+}
+
+
+// 64x64 patch with two posts per column, like a typical sprite
+patch_t* makeSyntheticPatch()
+{
+  constexpr auto WIDTH = 64;
+  constexpr auto HEIGHT = 64;
+
+  auto& buffer = syntheticStorage.emplace_back();
+  buffer.resize(8 + WIDTH * 4);
+
+  for (auto x = 0; x < WIDTH; ++x)
+  {
+    const auto offset = int32_t(buffer.size());
+    std::memcpy(buffer.data() + 8 + x * 4, &offset, sizeof(offset));
+
+    for (const auto& [topdelta, length] : {std::pair{0, 32}, std::pair{40, 24}})
+    {
+      buffer.push_back(byte(topdelta));
+      buffer.push_back(byte(length));
+      buffer.push_back(0);
+
+      for (auto i = 0; i < length; ++i)
+      {
+        buffer.push_back(byte(rand()));
+      }
+
+      buffer.push_back(0);
+    }
+
+    buffer.push_back(0xff);
+  }
+
+  const short header[] = {WIDTH, HEIGHT, 0, 0};
+  std::memcpy(buffer.data(), header, sizeof(header));
+
+  return reinterpret_cast<patch_t*>(buffer.data());
+}
+
+
+// Score playing chords on all primary channels and the percussion channel
+std::vector<byte> makeSyntheticMus()
+{
+  std::vector<byte> score;
+
+  for (auto i = 0; i < 1000; ++i)
+  {
+    const auto channel = i % 9 == 8 ? 15 : i % 9;
+    const auto key = byte(36 + (i * 7) % 48);
+
+    // Press key with volume, then release it after a delay
+    score.push_back(byte(0x10 | channel));
+    score.push_back(byte(key | 0x80));
+    score.push_back(byte(64 + i % 64));
+    score.push_back(byte(0x80 | channel));
+    score.push_back(key);
+    score.push_back(byte(1 + i % 16));
+  }
+
+  score.push_back(0x60);
+
+  const uint16_t header[] = {uint16_t(score.size()), 16, 8, 0, 0, 0};
+
+  std::vector<byte> mus = {'M', 'U', 'S', 0x1a};
+  mus.resize(16);
+  std::memcpy(mus.data() + 4, header, 12);
+  mus.insert(mus.end(), score.begin(), score.end());
+
+  return mus;
+}
+
+
+BenchData makeSyntheticData()
+{
+  BenchData data;
+  data.name = "synthetic";
+
+  data.pColumn = makeSyntheticBuffer(128);
+  data.columnLength = 128;
+  data.pSpriteColumn = data.pColumn;
+  data.spriteColumnLength = 128;
+  data.pFlat = makeSyntheticBuffer(64 * 64);
+
+  data.pPatch = makeSyntheticPatch();
+  data.patchX = (SCREENWIDTH - 64) / 2;
+  data.patchY = (SCREENHEIGHT - 64) / 2;
+
+  data.mus = makeSyntheticMus();
+
+  for (auto i = 0; i < 1024; ++i)
+  {
+    auto pName = reinterpret_cast<char*>(makeSyntheticBuffer(9));
+
+    for (auto j = 0; j < 8; ++j)
+    {
+      pName[j] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_"[byte(pName[j]) % 37];
+    }
+
+    pName[1 + i % 8] = '\0';
+    data.lumpNames.push_back(pName);
+  }
+
+  data.pColormaps = makeSyntheticBuffer(34 * 256);
+
+  return data;
+}
+
+
+int findLump(const char* name, int fallback)
+{
+  const auto lump = W_CheckNumForName(const_cast<char*>(name));
+  return lump >= 0 ? lump : fallback;
+}
+
+
+BenchData loadWadData(char* filename)
+{
+  if (W_AddFile(filename) == nullptr)
+  {
+    I_Error(const_cast<char*>("doombench: couldn't open %s"), filename);
+  }
+
+  W_GenerateHashTable();
+
+  // Textures, flats, sprites and colormaps
+  R_InitData();
+  printf("\n");
+
+  BenchData data;
+  data.name = "wad";
+
+  data.pColormaps = colormaps;
+
+  auto texture = R_CheckTextureNumForName(const_cast<char*>("STARTAN3"));
+  data.pColumn = R_GetColumn(texture > 0 ? texture : 1, 32);
+  data.columnLength = 128;
+
+  // Middle column of the player sprite, which is what translated columns are used for
+  const auto pSprite =
+    static_cast<patch_t*>(W_CacheLumpNum(findLump("PLAYA1", firstspritelump), PU_STATIC));
+  const auto pPost = reinterpret_cast<byte*>(pSprite)
+                     + LONG(pSprite->columnofs[SHORT(pSprite->width) / 2]);
+  data.pSpriteColumn = pPost + 3;
+  data.spriteColumnLength = pPost[1];
+
+  data.pFlat =
+    static_cast<byte*>(W_CacheLumpNum(findLump("FLOOR4_8", firstflat + 1), PU_STATIC));
+
+  data.pPatch = static_cast<patch_t*>(
+    W_CacheLumpNum(W_GetNumForName(const_cast<char*>("TITLEPIC")), PU_STATIC));
+
+  if (const auto lump = findLump("D_E1M1", findLump("D_RUNNIN", -1)); lump >= 0)
+  {
+    const auto pMus = static_cast<byte*>(W_CacheLumpNum(lump, PU_STATIC));
+    data.mus.assign(pMus, pMus + W_LumpLength(lump));
+  }
+
+  for (auto i = 0u; i < numlumps; ++i)
+  {
+    data.lumpNames.push_back(lumpinfo[i].name);
+  }
+
+  return data;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+//
+// Kernels
+//
+//////////////////////////////////////////////////////////////////////////////////////////
+
+volatile unsigned int hashSink;
+
+
+// A full height column at the next x position, scaled so that the source is
+// stretched over the whole column
+void setupColumn(int i, byte* pSource, int sourceLength)
+{
+  dc_x = i % SCREENWIDTH;
+  dc_yl = 1;
+  dc_yh = viewheight - 2;
+  dc_iscale = (sourceLength << FRACBITS) / viewheight;
+  dc_texturemid = centery * dc_iscale;
+  dc_source = pSource;
+}
+
+
+std::vector<Kernel> makeKernels(const BenchData& data, bool includeDataIndependent)
+{
+  std::vector<Kernel> kernels;
+
+  const auto columnBytes = size_t(viewheight - 2);
+
+  kernels.push_back({"R_DrawColumn", columnBytes, [&data](int n) {
+                       dc_colormap = data.pColormaps;
+
+                       for (auto i = 0; i < n; ++i)
+                       {
+                         setupColumn(i, data.pColumn, data.columnLength);
+                         R_DrawColumn();
+                       }
+                     }});
+
+  kernels.push_back({"R_DrawFuzzColumn", columnBytes, [&data](int n) {
+                       colormaps = data.pColormaps;
+
+                       for (auto i = 0; i < n; ++i)
+                       {
+                         setupColumn(i, data.pSpriteColumn, data.spriteColumnLength);
+                         R_DrawFuzzColumn();
+                       }
+                     }});
+
+  kernels.push_back({"R_DrawTranslatedColumn", columnBytes, [&data](int n) {
+                       dc_colormap = data.pColormaps;
+                       dc_translation = translationtables;
+
+                       for (auto i = 0; i < n; ++i)
+                       {
+                         setupColumn(i, data.pSpriteColumn, data.spriteColumnLength);
+                         R_DrawTranslatedColumn();
+                       }
+                     }});
+
+  // Full width spans, stepping diagonally through the flat
+  kernels.push_back({"R_DrawSpan", size_t(SCREENWIDTH), [&data](int n) {
+                       ds_colormap = data.pColormaps;
+                       ds_source = data.pFlat;
+                       ds_x1 = 0;
+                       ds_x2 = SCREENWIDTH - 1;
+                       ds_xstep = FRACUNIT * 3 / 4;
+                       ds_ystep = FRACUNIT / 3;
+
+                       for (auto i = 0; i < n; ++i)
+                       {
+                         ds_y = i % SCREENHEIGHT;
+                         ds_xfrac = i << 12;
+                         ds_yfrac = i << 13;
+                         R_DrawSpan();
+                       }
+                     }});
+
+  kernels.push_back(
+    {"V_DrawPatch",
+     size_t(SHORT(data.pPatch->width) * SHORT(data.pPatch->height)),
+     [&data](int n) {
+       for (auto i = 0; i < n; ++i)
+       {
+         V_DrawPatch(data.patchX, data.patchY, data.pPatch);
+       }
+     }});
+
+  if (!data.mus.empty())
+  {
+    kernels.push_back({"mus2mid", data.mus.size(), [&data](int n) {
+                         for (auto i = 0; i < n; ++i)
+                         {
+                           auto pInput = mem_fopen_read(
+                             const_cast<byte*>(data.mus.data()), data.mus.size());
+                           auto pOutput = mem_fopen_write();
+
+                           mus2mid(pInput, pOutput);
+
+                           mem_fclose(pInput);
+                           mem_fclose(pOutput);
+                         }
+                       }});
+  }
+
+  kernels.push_back({"W_LumpNameHash", 8, [&data](int n) {
+                       const auto count = int(data.lumpNames.size());
+                       auto hash = 0u;
+
+                       for (auto i = 0; i < n; ++i)
+                       {
+                         hash += W_LumpNameHash(data.lumpNames[i % count]);
+                       }
+
+                       hashSink = hash;
+                     }});
+
+  if (!includeDataIndependent)
+  {
+    return kernels;
+  }
+
+  // Whole frame, as done by I_FinishUpdate()
+  kernels.push_back({"cmap_to_fb", size_t(SCREENWIDTH * SCREENHEIGHT * 4), [](int n) {
+                       for (auto i = 0; i < n; ++i)
+                       {
+                         for (auto y = 0; y < SCREENHEIGHT; ++y)
+                         {
+                           cmap_to_fb(
+                             reinterpret_cast<uint8_t*>(DG_ScreenBuffer + y * SCREENWIDTH),
+                             I_VideoBuffer + y * SCREENWIDTH,
+                             SCREENWIDTH);
+                         }
+                       }
+                     }});
+
+  // Whole frame, in the same layout as DoomGame::updateScreen(): the top part in the
+  // center of the display, the rest to its right
+  static std::vector<uint16_t> pushScreen(PUSH_SCREEN_HEIGHT * PUSH_SCREEN_STRIDE);
+  static std::vector<uint8_t> usbBuffer(pushScreen.size() * sizeof(uint16_t));
+
+  kernels.push_back(
+    {"toBGR565", size_t(DOOMGENERIC_RESX * DOOMGENERIC_RESY * 2), [](int n) {
+       const auto mainCenter = (PUSH_SCREEN_WIDTH - DOOMGENERIC_RESX) / 2;
+
+       for (auto i = 0; i < n; ++i)
+       {
+         for (auto y = 0; y < DOOMGENERIC_RESY; ++y)
+         {
+           const auto destX =
+             y < PUSH_SCREEN_HEIGHT ? mainCenter : mainCenter + DOOMGENERIC_RESX;
+           const auto destY = y % PUSH_SCREEN_HEIGHT;
+
+           convertToBGR565(
+             pushScreen.data() + destX + destY * PUSH_SCREEN_STRIDE,
+             DG_ScreenBuffer + y * DOOMGENERIC_RESX,
+             DOOMGENERIC_RESX);
+         }
+       }
+     }});
+
+  kernels.push_back({"encodeDisplayData", usbBuffer.size(), [](int n) {
+                       for (auto i = 0; i < n; ++i)
+                       {
+                         encodeDisplayData(
+                           usbBuffer.data(), pushScreen.data(), usbBuffer.size());
+                       }
+                     }});
+
+  // Allocations of mixed sizes, each one freeing the block allocated 64 steps before
+  kernels.push_back({"Z_Malloc/Z_Free", 0, [](int n) {
+                       static void* blocks[64];
+
+                       for (auto i = 0; i < n; ++i)
+                       {
+                         auto& pBlock = blocks[i % 64];
+
+                         if (pBlock)
+                         {
+                           Z_Free(pBlock);
+                         }
+
+                         pBlock = Z_Malloc(16 + (i * 2654435761u >> 20) % 4096, PU_STATIC, 0);
+                       }
+                     }});
+
+  return kernels;
+}
+
+
+void runKernels(
+  const std::vector<Kernel>& kernels,
+  const std::string& dataName,
+  const char* only,
+  int samples,
+  uint64_t sampleNs)
+{
+  for (const auto& kernel : kernels)
+  {
+    if (only && kernel.name.find(only) == std::string::npos)
+    {
+      continue;
+    }
+
+    const auto result = measure(kernel, samples, sampleNs);
+
+    printf("%-24s %-10s %12.1f", kernel.name.c_str(), dataName.c_str(), result.nsPerOp);
+
+    if (result.cyclesPerOp > 0)
+    {
+      printf(" %12.1f", result.cyclesPerOp);
+    }
+    else
+    {
+      printf(" %12s", "-");
+    }
+
+    if (kernel.bytesPerOp > 0 && result.cyclesPerOp > 0)
+    {
+      printf(" %10zu %10.2f\n", kernel.bytesPerOp, kernel.bytesPerOp / result.cyclesPerOp);
+    }
+    else if (kernel.bytesPerOp > 0)
+    {
+      printf(" %10zu %10s\n", kernel.bytesPerOp, "-");
+    }
+    else
+    {
+      printf(" %10s %10s\n", "-", "-");
+    }
+  }
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+  myargc = argc;
+  myargv = argv;
+
+  auto p = M_CheckParmWithArgs(const_cast<char*>("-only"), 1);
+  const auto only = p > 0 ? myargv[p + 1] : nullptr;
+
+  p = M_CheckParmWithArgs(const_cast<char*>("-samples"), 1);
+  const auto samples = p > 0 ? std::max(atoi(myargv[p + 1]), 1) : 10;
+
+  p = M_CheckParmWithArgs(const_cast<char*>("-sampletime"), 1);
+  const auto sampleNs = uint64_t(p > 0 ? atoi(myargv[p + 1]) : 20) * 1000000;
+
+  DG_ScreenBuffer =
+    static_cast<pixel_t*>(malloc(DOOMGENERIC_RESX * DOOMGENERIC_RESY * sizeof(pixel_t)));
+
+  Z_Init();
+  I_InitGraphics();
+  V_Init();
+  V_RestoreBuffer();
+  R_InitTranslationTables();
+
+  // Full screen view, so that columns and spans can go anywhere
+  R_InitBuffer(SCREENWIDTH, SCREENHEIGHT);
+  viewheight = SCREENHEIGHT;
+  centery = viewheight / 2;
+
+  for (auto i = 0; i < SCREENWIDTH * SCREENHEIGHT; ++i)
+  {
+    I_VideoBuffer[i] = byte(rand());
+  }
+
+  std::vector<byte> palette(768);
+
+  for (auto i = 0u; i < palette.size(); ++i)
+  {
+    palette[i] = byte(i * 3);
+  }
+
+  I_SetPalette(palette.data());
+
+  // Load everything up front, as loading prints progress
+  std::vector<BenchData> dataSets;
+  dataSets.push_back(makeSyntheticData());
+
+  p = M_CheckParmWithArgs(const_cast<char*>("-iwad"), 1);
+
+  if (p > 0)
+  {
+    dataSets.push_back(loadWadData(myargv[p + 1]));
+  }
+
+  printf(
+    "\n%-24s %-10s %12s %12s %10s %10s\n",
+    "kernel",
+    "data",
+    "ns/op",
+    "cycles/op",
+    "bytes/op",
+    "bytes/cycle");
+
+  for (const auto& data : dataSets)
+  {
+    // The data independent kernels only need to run once
+    const auto kernels = makeKernels(data, &data == &dataSets.front());
+    runKernels(kernels, data.name, only, samples, sampleNs);
+  }
+
+  return 0;
+}
@@ -27,9 +27,8 @@
 
 #undef FEATURE_DEHACKED
 
-// Enables multiplayer support (network games)
-
-#undef FEATURE_MULTIPLAYER
+// Enables multiplayer support (network games). Defined by the desktop
+// Makefiles (Makefile, Makefile.sdl and Makefile.freebsd).
 
 // Enables sound output
 
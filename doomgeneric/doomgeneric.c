@@ -5,9 +5,11 @@
 #include "doomgeneric.h"
 
 pixel_t* DG_ScreenBuffer = NULL;
+uint8_t DG_DirtyRows[DOOMGENERIC_RESY];
 
 void M_FindResponseFile(void);
 void D_DoomMain (void);
+void D_StartupMark (char *name);
 
 
 void doomgeneric_Create(int argc, char **argv)
@@ -20,7 +22,10 @@ void doomgeneric_Create(int argc, char **argv)
 
 	DG_ScreenBuffer = malloc(DOOMGENERIC_RESX * DOOMGENERIC_RESY * 4);
 
+	D_StartupMark("start");
+
 	DG_Init();
+	D_StartupMark("DG_Init");
 
 	D_DoomMain ();
 }
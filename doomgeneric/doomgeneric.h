@@ -26,6 +26,10 @@ typedef uint32_t pixel_t;
 
 extern pixel_t* DG_ScreenBuffer;
 
+// Nonzero for each row of DG_ScreenBuffer that changed since the last
+// DG_DrawFrame() call, so that unchanged rows can be skipped.
+extern uint8_t DG_DirtyRows[DOOMGENERIC_RESY];
+
 #ifdef __cplusplus
 extern "C" {
 #endif
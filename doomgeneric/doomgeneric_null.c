@@ -0,0 +1,103 @@
+/* AbleDOOM - Doom on Ableton Push 3 Standalone!
+ *
+ * Copyright (C) 2024 Nikolai Wuttke-Hohendorf
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Headless platform layer without any display or input.  The game still
+// renders every frame into DG_ScreenBuffer, so this is used to benchmark
+// and to gather profiles with -timedemo (see Makefile.pgo).
+
+#include "doomgeneric.h"
+#include "i_system.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+
+static struct timespec startTime;
+
+
+// I_Error() and I_Quit() don't exit after running the exit functions.
+// These are registered first, so they run last, and make sure that the
+// process terminates and that profile data gets written out. I_Error()
+// only runs DG_ErrorExit, so that errors (including the end of a
+// -timedemo) give a failure status.
+static void DG_Exit(void)
+{
+  exit(0);
+}
+
+static void DG_ErrorExit(void)
+{
+  exit(1);
+}
+
+
+void DG_Init()
+{
+  // Store initial time for DG_GetTicksMs()
+  clock_gettime(CLOCK_MONOTONIC_RAW, &startTime);
+
+  I_AtExit(DG_ErrorExit, true);
+  I_AtExit(DG_Exit, false);
+}
+
+
+void DG_DrawFrame()
+{
+  // No-op
+}
+
+
+int DG_GetKey(int* pressed, unsigned char* doomKey)
+{
+  return 0;
+}
+
+
+void DG_SleepMs(uint32_t ms)
+{
+  usleep(ms * 1000);
+}
+
+
+uint32_t DG_GetTicksMs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+
+  const long secsElapsed = now.tv_sec - startTime.tv_sec;
+  const long nanosElapsed = now.tv_nsec - startTime.tv_nsec;
+
+  return (uint32_t)(secsElapsed * 1000 + nanosElapsed / 1000000);
+}
+
+
+void DG_SetWindowTitle(const char* title)
+{
+  // No-op
+}
+
+
+int main(int argc, char** argv)
+{
+  doomgeneric_Create(argc, argv);
+
+  for (;;)
+  {
+    doomgeneric_Tick();
+  }
+
+  return 0;
+}
@@ -24,10 +24,14 @@
  *  public data                                                        *
  *---------------------------------------------------------------------*/
 
+#ifndef FEATURE_MULTIPLAYER
+
 boolean net_client_connected = false;
 
 boolean drone = false;
 
+#endif
+
 /*---------------------------------------------------------------------*
  *  private data                                                       *
  *---------------------------------------------------------------------*/
@@ -39,28 +39,6 @@ static byte*	wipe_scr_end;
 static byte*	wipe_scr;
 
 
-void
-wipe_shittyColMajorXform
-( short*	array,
-  int		width,
-  int		height )
-{
-    int		x;
-    int		y;
-    short*	dest;
-
-    dest = (short*) Z_Malloc(width*height*2, PU_STATIC, 0);
-
-    for(y=0;y<height;y++)
-	for(x=0;x<width;x++)
-	    dest[x*height+y] = array[y*width+x];
-
-    memcpy(array, dest, width*height*2);
-
-    Z_Free(dest);
-
-}
-
 int
 wipe_initColorXForm
 ( int	width,
@@ -82,6 +60,8 @@ wipe_doColorXForm
     byte*	e;
     int		newval;
 
+    V_MarkRect(0, 0, width, height);
+
     changed = false;
     w = wipe_scr;
     e = wipe_scr_end;
@@ -127,7 +107,20 @@ wipe_exitColorXForm
 }
 
 
+// The melt works on pairs of pixels, like the original did.
+// y[i] is how far column pair i has melted (y<0 => not ready to
+// scroll yet), ynew[i] and dy[i] are the new position and the step
+// for the current tic.
+//
+// wipe_scr_start is melted in place: rows above y[i] have been
+// replaced by the end screen, and the rest of the start screen has
+// been moved down by y[i]. Everything stays row-major, so whole runs
+// of columns moving by the same amount are moved with memcpy, and
+// only the rows that changed are copied to the screen.
+
 static int*	y;
+static int*	ynew;
+static int*	dy;
 
 int
 wipe_initMelt
@@ -140,14 +133,11 @@ wipe_initMelt
     // copy start screen to main screen
     memcpy(wipe_scr, wipe_scr_start, width*height);
     
-    // makes this wipe faster (in theory)
-    // to have stuff in column-major format
-    wipe_shittyColMajorXform((short*)wipe_scr_start, width/2, height);
-    wipe_shittyColMajorXform((short*)wipe_scr_end, width/2, height);
-    
     // setup initial column positions
     // (y<0 => not ready to scroll yet)
     y = (int *) Z_Malloc(width*sizeof(int), PU_STATIC, 0);
+    ynew = (int *) Z_Malloc(width*sizeof(int), PU_STATIC, 0);
+    dy = (int *) Z_Malloc(width*sizeof(int), PU_STATIC, 0);
     y[0] = -(M_Random()%16);
     for (i=1;i<width;i++)
     {
@@ -160,6 +150,66 @@ wipe_initMelt
     return 0;
 }
 
+//
+// wipe_meltColumns
+// Moves the column pairs first to last-1, which all step by the
+// same amount, down to their new positions.
+//
+
+static void
+wipe_meltColumns
+( int	first,
+  int	last,
+  int	width,
+  int	height )
+{
+    short*	scr;
+    short*	end;
+    int		step;
+    int		top;
+    int		bottom;
+    int		row;
+    int		i;
+
+    scr = (short *) wipe_scr_start;
+    end = (short *) wipe_scr_end;
+    step = dy[first];
+
+    // Rows from bottom down are below every column's new position,
+    // so they are just a shifted copy of the row step rows up.
+    // Go bottom-up, so that nothing is overwritten before it's read.
+
+    top = y[first];
+    bottom = ynew[first];
+
+    for (i=first+1;i<last;i++)
+    {
+	if (y[i] < top) top = y[i];
+	if (ynew[i] > bottom) bottom = ynew[i];
+    }
+
+    for (row=height-1;row>=bottom;row--)
+    {
+	memcpy(&scr[row*width+first], &scr[(row-step)*width+first],
+	       (last-first)*sizeof(short));
+    }
+
+    // In the rows between, each column is either still the start
+    // screen, the end screen coming in, or the start screen moving
+    // down.
+
+    for (;row>=top;row--)
+    {
+	for (i=first;i<last;i++)
+	{
+	    if (row >= ynew[i])
+		scr[row*width+i] = scr[(row-step)*width+i];
+	    else if (row >= y[i])
+		scr[row*width+i] = end[row*width+i];
+	}
+    }
+}
+
 int
 wipe_doMelt
 ( int	width,
@@ -167,48 +217,62 @@ wipe_doMelt
   int	ticks )
 {
     int		i;
-    int		j;
-    int		dy;
-    int		idx;
-    
-    short*	s;
-    short*	d;
+    int		first;
+    int		dirty;
     boolean	done = true;
 
     width/=2;
 
+    // First changed row, over all tics.
+    dirty = height;
+
     while (ticks--)
     {
 	for (i=0;i<width;i++)
 	{
+	    dy[i] = 0;
+
 	    if (y[i]<0)
 	    {
 		y[i]++; done = false;
 	    }
 	    else if (y[i] < height)
 	    {
-		dy = (y[i] < 16) ? y[i]+1 : 8;
-		if (y[i]+dy >= height) dy = height - y[i];
-		s = &((short *)wipe_scr_end)[i*height+y[i]];
-		d = &((short *)wipe_scr)[y[i]*width+i];
-		idx = 0;
-		for (j=dy;j;j--)
-		{
-		    d[idx] = *(s++);
-		    idx += width;
-		}
-		y[i] += dy;
-		s = &((short *)wipe_scr_start)[i*height];
-		d = &((short *)wipe_scr)[y[i]*width+i];
-		idx = 0;
-		for (j=height-y[i];j;j--)
-		{
-		    d[idx] = *(s++);
-		    idx += width;
-		}
+		dy[i] = (y[i] < 16) ? y[i]+1 : 8;
+		if (y[i]+dy[i] >= height) dy[i] = height - y[i];
+		ynew[i] = y[i] + dy[i];
+		if (y[i] < dirty) dirty = y[i];
 		done = false;
 	    }
 	}
+
+	// Move each run of columns that step by the same amount
+	// together.
+
+	for (i=0;i<width;)
+	{
+	    if (dy[i] == 0)
+	    {
+		i++;
+		continue;
+	    }
+
+	    first = i;
+	    while (i < width && dy[i] == dy[first]) i++;
+	    wipe_meltColumns(first, i, width, height);
+	}
+
+	for (i=0;i<width;i++)
+	{
+	    if (dy[i] != 0) y[i] = ynew[i];
+	}
+    }
+
+    if (dirty < height)
+    {
+	memcpy(wipe_scr + dirty*width*2, wipe_scr_start + dirty*width*2,
+	       (height-dirty)*width*2);
+	V_MarkRect(0, dirty, width*2, height-dirty);
     }
 
     return done;
@@ -222,6 +286,8 @@ wipe_exitMelt
   int	ticks )
 {
     Z_Free(y);
+    Z_Free(ynew);
+    Z_Free(dy);
     Z_Free(wipe_scr_start);
     Z_Free(wipe_scr_end);
     return 0;
@@ -278,7 +344,6 @@ wipe_ScreenWipe
     }
 
     // do a piece of wipe-in
-    V_MarkRect(0, 0, width, height);
     rc = (*wipes[wipeno*3+1])(width, height, ticks);
     //  V_DrawBlock(x, y, 0, width, height, wipe_scr); // DEBUG
 
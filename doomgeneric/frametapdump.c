@@ -0,0 +1,178 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Reference reader for the -frametap shared memory export.
+//	Prints the metadata of every frame it sees and optionally
+//	writes the frames out as PPM images.
+//
+//	Usage: frametapdump <name> [count] [prefix]
+//
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "i_frametap.h"
+
+// Copy a consistent snapshot of the given slot, or return 0 if
+// the game overwrote it while we were reading.
+
+static int ReadSlot(frametap_frame_t *slot, frametap_frame_t *out)
+{
+    uint32_t sequence;
+
+    sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+    if (sequence & 1)
+    {
+        return 0;
+    }
+
+    memcpy(out, slot, sizeof(*out));
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+static void WritePPM(const char *prefix, frametap_frame_t *frame)
+{
+    char filename[256];
+    FILE *handle;
+    uint8_t *rgb;
+    int i;
+
+    snprintf(filename, sizeof(filename), "%s%06u.ppm", prefix, frame->frame);
+
+    handle = fopen(filename, "wb");
+
+    if (handle == NULL)
+    {
+        fprintf(stderr, "Couldn't create %s\n", filename);
+        exit(1);
+    }
+
+    fprintf(handle, "P6\n%d %d\n255\n", FRAMETAP_WIDTH, FRAMETAP_HEIGHT);
+
+    for (i = 0; i < FRAMETAP_WIDTH * FRAMETAP_HEIGHT; ++i)
+    {
+        rgb = &frame->palette[frame->pixels[i] * 3];
+        fwrite(rgb, 1, 3, handle);
+    }
+
+    fclose(handle);
+}
+
+int main(int argc, char **argv)
+{
+    frametap_t *frametap;
+    frametap_frame_t *frame;
+    uint32_t numframes;
+    uint32_t lastframe;
+    uint64_t lasttime;
+    int count;
+    int fd;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <name> [count] [prefix]\n", argv[0]);
+        return 1;
+    }
+
+    count = argc > 2 ? atoi(argv[2]) : 0;
+
+    fd = shm_open(argv[1], O_RDONLY, 0);
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "Couldn't open %s, is the game running "
+                        "with -frametap?\n", argv[1]);
+        return 1;
+    }
+
+    frametap = mmap(NULL, sizeof(*frametap), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (frametap == MAP_FAILED)
+    {
+        fprintf(stderr, "Couldn't map %s\n", argv[1]);
+        return 1;
+    }
+
+    while (__atomic_load_n(&frametap->magic, __ATOMIC_ACQUIRE)
+           != FRAMETAP_MAGIC)
+    {
+        usleep(1000);
+    }
+
+    if (frametap->version != FRAMETAP_VERSION
+     || frametap->width != FRAMETAP_WIDTH
+     || frametap->height != FRAMETAP_HEIGHT
+     || frametap->numslots != FRAMETAP_SLOTS)
+    {
+        fprintf(stderr, "%s has an unsupported layout\n", argv[1]);
+        return 1;
+    }
+
+    frame = malloc(sizeof(*frame));
+    lastframe = 0;
+    lasttime = 0;
+
+    while (count == 0 || count-- > 0)
+    {
+        // Wait for a frame we haven't seen yet, and take the newest.
+
+        for (;;)
+        {
+            numframes = __atomic_load_n(&frametap->numframes,
+                                        __ATOMIC_ACQUIRE);
+
+            if (numframes > lastframe
+             && ReadSlot(&frametap->frames[(numframes - 1) % FRAMETAP_SLOTS],
+                         frame))
+            {
+                break;
+            }
+
+            usleep(1000);
+        }
+
+        printf("frame %u tic %u E%dM%d %.3f ms",
+               frame->frame, frame->tic, frame->episode, frame->map,
+               lasttime != 0 ? (frame->timestamp - lasttime) / 1e6 : 0.0);
+
+        if (lasttime != 0 && frame->frame > lastframe)
+        {
+            printf(" (%u skipped)", frame->frame - lastframe);
+        }
+
+        printf("\n");
+
+        if (argc > 3)
+        {
+            WritePPM(argv[3], frame);
+        }
+
+        lastframe = frame->frame + 1;
+        lasttime = frame->timestamp;
+    }
+
+    free(frame);
+    munmap(frametap, sizeof(*frametap));
+
+    return 0;
+}
@@ -35,6 +35,10 @@
 #include "m_misc.h"
 #include "m_menu.h"
 #include "m_random.h"
+#include "i_perf.h"
+#ifdef ALLOCTRACK
+#include "i_alloctrack.h"
+#endif
 #include "i_system.h"
 #include "i_timer.h"
 #include "i_video.h"
@@ -1005,7 +1009,9 @@ void G_Ticker (void)
     switch (gamestate) 
     { 
       case GS_LEVEL: 
+	I_PerfBegin (PERF_TICKER);
 	P_Ticker (); 
+	I_PerfEnd (PERF_TICKER, 0);
 	ST_Ticker (); 
 	AM_Ticker (); 
 	HU_Ticker ();            
@@ -1732,6 +1738,9 @@ G_InitNew
     char *skytexturename;
     int             i;
 
+    // Textures, sprites etc. may not be set up yet with -faststart
+    D_FinishStartup ();
+
     if (paused)
     {
 	paused = false;
@@ -2262,6 +2271,12 @@ boolean G_CheckDemoStatus (void)
         timingdemo = false;
         demoplayback = false;
 
+        I_PrintPerfCounters ();
+        I_PrintEnergy ();
+#ifdef ALLOCTRACK
+        I_PrintAllocations ();
+#endif
+
 	I_Error ("timed %i gametics in %i realtics (%f fps)",
                  gametic, realtics, fps);
     } 
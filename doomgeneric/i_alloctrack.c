@@ -0,0 +1,425 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Allocation tracking.
+//      Builds with ALLOCTRACK defined (make -f Makefile.pushstandalone
+//      ALLOCTRACK=1) link this, which replaces malloc() and friends,
+//      including the aligned ones, with versions that count the
+//      allocations made by the main thread before handing them to
+//      glibc. That covers the C++ code too, as operator new allocates
+//      through malloc(), and the aligned operator new through
+//      aligned_alloc(). Zone allocations are counted by Z_Malloc and
+//      Z_Free.
+//
+//      With -trackallocs, allocations are counted per frame and per
+//      frame phase (see I_PerfBegin), and a report is printed at the
+//      end of a -timedemo or on exit. With -zeroalloc, any heap
+//      allocation in a frame during demo playback is an error, once
+//      the demo has warmed up. Run it on the headless build
+//      (PLATFORM=null), where I_Error() exits with a failure status,
+//      and with -playdemo, which quits normally at the end of the
+//      demo. The end of a -timedemo goes through I_Error() as well.
+//
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <execinfo.h>
+#include <unistd.h>
+
+#include "doomstat.h"
+#include "i_alloctrack.h"
+#include "i_system.h"
+#include "m_argv.h"
+
+// glibc's allocator, which the replacements below hand over to
+extern void*	__libc_malloc (size_t size);
+extern void*	__libc_calloc (size_t count, size_t size);
+extern void*	__libc_realloc (void* ptr, size_t size);
+extern void*	__libc_memalign (size_t alignment, size_t size);
+extern void*	__libc_valloc (size_t size);
+extern void*	__libc_pvalloc (size_t size);
+extern void	__libc_free (void* ptr);
+
+#define MAXALLOCTRACE 16
+
+typedef struct
+{
+    uint64_t	heapallocs;
+    uint64_t	heapbytes;
+    uint64_t	heapfrees;
+    uint64_t	zoneallocs;
+    uint64_t	zonebytes;
+    uint64_t	zonefrees;
+
+} alloccount_t;
+
+typedef struct
+{
+    int			calls;
+    alloccount_t	start;
+    alloccount_t	total;
+
+} allocphase_t;
+
+boolean			alloctracking;
+
+// Only the thread that called I_InitAllocTracking is counted, so that
+// the sound and worker threads are left out.
+static __thread boolean	trackedthread;
+
+// Set while taking a backtrace, which may allocate itself.
+static __thread boolean	intracker;
+
+// Everything counted so far, and where the report and the current
+// frame started.
+static alloccount_t	alloccount;
+static alloccount_t	reportstart;
+static alloccount_t	framestart;
+
+static allocphase_t	allocphases[NUMPERFPHASES];
+
+static int		allocframes;
+static int		allocatingframes;
+static uint64_t		maxframeallocs;
+
+// -zeroalloc
+static boolean		zeroalloc;
+static int		zeroallocwarmup;
+static int		demoframes;
+
+// Call stack of the first heap allocation in the frame, with -zeroalloc
+static void*		alloctrace[MAXALLOCTRACE];
+static int		alloctracesize;
+static size_t		alloctracebytes;
+
+static boolean I_ZeroAllocArmed (void)
+{
+    return zeroalloc && demoplayback && demoframes >= zeroallocwarmup;
+}
+
+static void I_CountHeapAlloc (size_t size)
+{
+    if (!trackedthread || intracker)
+    {
+        return;
+    }
+
+    alloccount.heapallocs++;
+    alloccount.heapbytes += size;
+
+    if (alloctracesize == 0 && I_ZeroAllocArmed())
+    {
+        intracker = true;
+        alloctracesize = backtrace(alloctrace, MAXALLOCTRACE);
+        alloctracebytes = size;
+        intracker = false;
+    }
+}
+
+void* malloc (size_t size)
+{
+    I_CountHeapAlloc(size);
+
+    return __libc_malloc(size);
+}
+
+void* calloc (size_t count, size_t size)
+{
+    I_CountHeapAlloc(count * size);
+
+    return __libc_calloc(count, size);
+}
+
+void* realloc (void* ptr, size_t size)
+{
+    I_CountHeapAlloc(size);
+
+    return __libc_realloc(ptr, size);
+}
+
+// glibc has no __libc_ versions of posix_memalign() and
+// aligned_alloc(), so these go through __libc_memalign().
+
+void* memalign (size_t alignment, size_t size)
+{
+    I_CountHeapAlloc(size);
+
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc (size_t alignment, size_t size)
+{
+    I_CountHeapAlloc(size);
+
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign (void** ptr, size_t alignment, size_t size)
+{
+    void* result;
+
+    if (alignment % sizeof(void*) != 0
+     || (alignment & (alignment - 1)) != 0
+     || alignment == 0)
+    {
+        return EINVAL;
+    }
+
+    I_CountHeapAlloc(size);
+
+    result = __libc_memalign(alignment, size);
+
+    if (result == NULL)
+    {
+        return ENOMEM;
+    }
+
+    *ptr = result;
+
+    return 0;
+}
+
+void* valloc (size_t size)
+{
+    I_CountHeapAlloc(size);
+
+    return __libc_valloc(size);
+}
+
+void* pvalloc (size_t size)
+{
+    I_CountHeapAlloc(size);
+
+    return __libc_pvalloc(size);
+}
+
+void free (void* ptr)
+{
+    if (ptr != NULL && trackedthread && !intracker)
+    {
+        alloccount.heapfrees++;
+    }
+
+    __libc_free(ptr);
+}
+
+void I_CountZoneAlloc (int size)
+{
+    if (trackedthread)
+    {
+        alloccount.zoneallocs++;
+        alloccount.zonebytes += size;
+    }
+}
+
+void I_CountZoneFree (void)
+{
+    if (trackedthread)
+    {
+        alloccount.zonefrees++;
+    }
+}
+
+// Add what has been counted since `start` to `total`.
+static void I_AddAllocCount (alloccount_t* total, alloccount_t* start)
+{
+    total->heapallocs += alloccount.heapallocs - start->heapallocs;
+    total->heapbytes += alloccount.heapbytes - start->heapbytes;
+    total->heapfrees += alloccount.heapfrees - start->heapfrees;
+    total->zoneallocs += alloccount.zoneallocs - start->zoneallocs;
+    total->zonebytes += alloccount.zonebytes - start->zonebytes;
+    total->zonefrees += alloccount.zonefrees - start->zonefrees;
+}
+
+void I_InitAllocTracking (void)
+{
+    int p;
+
+    //!
+    // @category obscure
+    // @arg <frames>
+    //
+    // Exit with an error if a frame allocates from the heap during
+    // demo playback, after the first <frames> frames of the demo.
+    // Use with -playdemo, not -timedemo, so that a clean run exits
+    // normally. Only in builds with ALLOCTRACK=1.
+    //
+
+    p = M_CheckParmWithArgs("-zeroalloc", 1);
+
+    if (p > 0)
+    {
+        zeroalloc = true;
+        zeroallocwarmup = atoi(myargv[p + 1]);
+    }
+
+    //!
+    // @category obscure
+    //
+    // Count heap and zone allocations per frame and per frame phase,
+    // and print a report at the end of a -timedemo, or on exit.
+    // Only in builds with ALLOCTRACK=1.
+    //
+
+    if (!zeroalloc && !M_CheckParm("-trackallocs"))
+    {
+        return;
+    }
+
+    // The first backtrace() loads the unwinder, which allocates.
+    backtrace(alloctrace, 1);
+
+    alloctracking = true;
+    trackedthread = true;
+
+    I_AtExit(I_PrintAllocations, true);
+}
+
+void I_AllocPhaseBegin (perfphase_t phase)
+{
+    if (alloctracking)
+    {
+        allocphases[phase].start = alloccount;
+    }
+}
+
+void I_AllocPhaseEnd (perfphase_t phase)
+{
+    if (alloctracking)
+    {
+        I_AddAllocCount(&allocphases[phase].total, &allocphases[phase].start);
+        allocphases[phase].calls++;
+    }
+}
+
+void I_AllocFrame (void)
+{
+    uint64_t	heapallocs;
+    int		i;
+
+    if (!alloctracking)
+    {
+        return;
+    }
+
+    heapallocs = alloccount.heapallocs - framestart.heapallocs;
+
+    allocframes++;
+
+    if (heapallocs > 0)
+    {
+        allocatingframes++;
+    }
+
+    if (heapallocs > maxframeallocs)
+    {
+        maxframeallocs = heapallocs;
+    }
+
+    if (heapallocs > 0 && I_ZeroAllocArmed())
+    {
+        if (alloctracesize > 0)
+        {
+            fprintf(stderr, "First allocation, of %i bytes, from:\n",
+                    (int) alloctracebytes);
+            backtrace_symbols_fd(alloctrace, alloctracesize, STDERR_FILENO);
+        }
+
+        for (i = 0; i < NUMPERFPHASES; ++i)
+        {
+            if (allocphases[i].total.heapallocs > 0)
+            {
+                fprintf(stderr, "  %s allocated %i times so far\n",
+                        I_PerfPhaseName(i),
+                        (int) allocphases[i].total.heapallocs);
+            }
+        }
+
+        zeroalloc = false;
+
+        I_Error("I_AllocFrame: %i heap allocations (%i bytes) "
+                "in frame %i of the demo",
+                (int) heapallocs,
+                (int) (alloccount.heapbytes - framestart.heapbytes),
+                demoframes);
+    }
+
+    if (demoplayback)
+    {
+        demoframes++;
+    }
+    else
+    {
+        demoframes = 0;
+    }
+
+    framestart = alloccount;
+    alloctracesize = 0;
+}
+
+static void I_PrintAllocLine (const char* name, int calls,
+                              alloccount_t* count)
+{
+    printf("  %-20s %8i %10.3f %10.3f %10.3f %10.3f\n", name, calls,
+           (double) count->heapallocs / calls,
+           count->heapbytes / 1024.0 / calls,
+           (double) count->zoneallocs / calls,
+           count->zonebytes / 1024.0 / calls);
+}
+
+void I_PrintAllocations (void)
+{
+    alloccount_t	total;
+    int			i;
+
+    if (!alloctracking || allocframes == 0)
+    {
+        return;
+    }
+
+    memset(&total, 0, sizeof(total));
+    I_AddAllocCount(&total, &reportstart);
+
+    printf("Allocations in %i frames:\n", allocframes);
+    printf("  %-20s %8s %10s %10s %10s %10s\n", "per call of",
+           "calls", "mallocs", "KiB", "Z_Mallocs", "KiB");
+
+    for (i = 0; i < NUMPERFPHASES; ++i)
+    {
+        if (allocphases[i].calls > 0)
+        {
+            I_PrintAllocLine(I_PerfPhaseName(i), allocphases[i].calls,
+                             &allocphases[i].total);
+        }
+
+        allocphases[i].calls = 0;
+        memset(&allocphases[i].total, 0, sizeof(allocphases[i].total));
+    }
+
+    I_PrintAllocLine("frame", allocframes, &total);
+
+    printf("  %i frames allocated from the heap, at most %i times; "
+           "%i frees, %i Z_Frees\n",
+           allocatingframes, (int) maxframeallocs,
+           (int) total.heapfrees, (int) total.zonefrees);
+
+    reportstart = alloccount;
+    allocframes = 0;
+    allocatingframes = 0;
+    maxframeallocs = 0;
+}
+
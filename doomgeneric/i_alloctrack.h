@@ -0,0 +1,47 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Allocation tracking, only in builds with ALLOCTRACK defined
+//
+
+
+#ifndef __I_ALLOCTRACK__
+#define __I_ALLOCTRACK__
+
+#include "doomtype.h"
+#include "i_perf.h"
+
+// set by -trackallocs or -zeroalloc
+extern boolean alloctracking;
+
+// Check the command line and start counting on this thread.
+void I_InitAllocTracking (void);
+
+// Called by Z_Malloc and Z_Free.
+void I_CountZoneAlloc (int size);
+void I_CountZoneFree (void);
+
+// Called by I_PerfBegin and I_PerfEnd.
+void I_AllocPhaseBegin (perfphase_t phase);
+void I_AllocPhaseEnd (perfphase_t phase);
+
+// Called once per frame of the main loop. With -zeroalloc, exits
+// with an error if the frame allocated from the heap during a demo.
+void I_AllocFrame (void);
+
+// Print what has been counted so far, and start over.
+void I_PrintAllocations (void);
+
+#endif
+
@@ -0,0 +1,70 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Layout of the -frametap shared memory object, shared between
+//	the game and external viewers such as frametapdump.
+//
+//	The game writes frame N into frames[N % FRAMETAP_SLOTS]. Each
+//	slot is guarded by a sequence lock: the sequence is odd while
+//	the slot is being written. A reader copies the slot out and
+//	retries if the sequence was odd or changed in the meantime, so
+//	the game never waits for readers.
+//
+
+#ifndef __I_FRAMETAP__
+#define __I_FRAMETAP__
+
+#include <stdint.h>
+
+#define FRAMETAP_MAGIC    0x50544644    // "DFTP"
+#define FRAMETAP_VERSION  1
+
+#define FRAMETAP_SLOTS    4
+#define FRAMETAP_WIDTH    320
+#define FRAMETAP_HEIGHT   200
+
+typedef struct
+{
+    uint32_t sequence;
+
+    // Frame number, game tic and level the frame was drawn on.
+    uint32_t frame;
+    uint32_t tic;
+    int32_t episode;
+    int32_t map;
+
+    // CLOCK_MONOTONIC time in nanoseconds when the frame was written.
+    uint64_t timestamp;
+
+    // Gamma corrected RGB palette and 8-bit pixels.
+    uint8_t palette[256 * 3];
+    uint8_t pixels[FRAMETAP_WIDTH * FRAMETAP_HEIGHT];
+} frametap_frame_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t numslots;
+
+    // Number of frames written so far; the newest is in
+    // frames[(numframes - 1) % numslots].
+    uint32_t numframes;
+
+    frametap_frame_t frames[FRAMETAP_SLOTS];
+} frametap_t;
+
+#endif
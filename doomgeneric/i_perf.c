@@ -0,0 +1,660 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Hardware performance counters, for profiling.
+//      With -perfcounters, CPU cycles, instructions, cache misses and
+//      branch misses are counted for each phase of a frame using
+//      perf_event_open(), and a report is printed at the end of a
+//      -timedemo or on exit. Counters the CPU or kernel don't provide
+//      are left out of the report.
+//
+//      With -energy, the RAPL energy counters are read once per frame
+//      from the powercap interface, and the energy used is reported
+//      for playing, menus, pausing and everything else.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "i_alloctrack.h"
+#include "i_perf.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+
+enum
+{
+    PERFC_CYCLES,
+    PERFC_INSTRUCTIONS,
+    PERFC_L1DMISSES,
+    PERFC_LLCMISSES,
+    PERFC_BRANCHMISSES,
+    NUMPERFCOUNTERS
+};
+
+typedef struct
+{
+    const char*	name;
+    int		calls;
+    uint64_t	pixels;
+    uint64_t	start[NUMPERFCOUNTERS];
+    uint64_t	total[NUMPERFCOUNTERS];
+
+    // Time the group was enabled and running for, when the phase began
+    uint64_t	startenabled;
+    uint64_t	startrunning;
+
+    // Calls during which the counters never got onto the CPU
+    int		notrunning;
+
+} perfphaseinfo_t;
+
+static perfphaseinfo_t perfphases[NUMPERFPHASES] =
+{
+    { "P_Ticker" },
+    { "R_RenderBSPNode" },
+    { "R_DrawPlanes" },
+    { "R_DrawMasked" },
+    { "I_FinishUpdate" },
+    { "AbleDoom::drawFrame" },
+};
+
+boolean		perfcounting;
+
+// Position of each counter in what is read from the group,
+// or -1 if it couldn't be opened.
+static int	perfslots[NUMPERFCOUNTERS];
+static int	numperfslots;
+
+// Set when the kernel had to share the counters with others. The
+// counts are then scaled up by the time the group was enabled over
+// the time it was running, which makes them estimates.
+static boolean	perfmultiplexed;
+
+#ifdef __linux__
+
+static int	perfgroupfd = -1;
+
+static const struct
+{
+    const char*	name;
+    uint32_t	type;
+    uint64_t	config;
+
+} perfcounterdefs[NUMPERFCOUNTERS] =
+{
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "L1d misses", PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_L1D
+    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { "LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+static int I_OpenPerfCounter (int counter, int groupfd)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = perfcounterdefs[counter].type;
+    attr.config = perfcounterdefs[counter].config;
+    attr.read_format = PERF_FORMAT_GROUP
+                     | PERF_FORMAT_TOTAL_TIME_ENABLED
+                     | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, groupfd, 0);
+}
+
+static void I_ReadPerfCounters (uint64_t* values, uint64_t* enabled,
+                                uint64_t* running)
+{
+    // nr, time enabled, time running, then one value per counter
+    uint64_t	buf[3 + NUMPERFCOUNTERS];
+    int		i;
+
+    if (read(perfgroupfd, buf, sizeof(buf)) < (ssize_t) (3 * sizeof(uint64_t)))
+    {
+        memset(values, 0, NUMPERFCOUNTERS * sizeof(uint64_t));
+        *enabled = 0;
+        *running = 0;
+        return;
+    }
+
+    *enabled = buf[1];
+    *running = buf[2];
+
+    for (i = 0; i < NUMPERFCOUNTERS; ++i)
+    {
+        values[i] = perfslots[i] >= 0 ? buf[3 + perfslots[i]] : 0;
+    }
+}
+
+#endif
+
+void I_InitPerfCounters (void)
+{
+#ifdef __linux__
+    int i;
+    int fd;
+#endif
+
+    //!
+    // @category obscure
+    //
+    // Count CPU cycles, instructions, cache and branch misses for
+    // each phase of a frame, using the hardware performance counters.
+    // A report is printed at the end of a -timedemo, or on exit.
+    //
+
+    if (!M_CheckParm("-perfcounters"))
+    {
+        return;
+    }
+
+#ifdef __linux__
+    numperfslots = 0;
+
+    for (i = 0; i < NUMPERFCOUNTERS; ++i)
+    {
+        perfslots[i] = -1;
+
+        fd = I_OpenPerfCounter(i, perfgroupfd);
+
+        if (fd < 0)
+        {
+            printf("I_InitPerfCounters: No %s counter: %s\n",
+                   perfcounterdefs[i].name, strerror(errno));
+            continue;
+        }
+
+        if (perfgroupfd < 0)
+        {
+            perfgroupfd = fd;
+        }
+
+        perfslots[i] = numperfslots++;
+    }
+
+    if (perfgroupfd < 0)
+    {
+        printf("I_InitPerfCounters: No performance counters available. "
+               "Check /proc/sys/kernel/perf_event_paranoid.\n");
+        return;
+    }
+
+    perfcounting = true;
+    I_AtExit(I_PrintPerfCounters, true);
+#else
+    printf("I_InitPerfCounters: Performance counters are only "
+           "supported on Linux.\n");
+#endif
+}
+
+void I_PerfBegin (perfphase_t phase)
+{
+#ifdef ALLOCTRACK
+    I_AllocPhaseBegin(phase);
+#endif
+
+#ifdef __linux__
+    if (perfcounting)
+    {
+        I_ReadPerfCounters(perfphases[phase].start,
+                           &perfphases[phase].startenabled,
+                           &perfphases[phase].startrunning);
+    }
+#endif
+}
+
+void I_PerfEnd (perfphase_t phase, int pixels)
+{
+#ifdef __linux__
+    perfphaseinfo_t*	info;
+    uint64_t		values[NUMPERFCOUNTERS];
+    uint64_t		enabled, running;
+    double		scale;
+    int			i;
+#endif
+
+#ifdef ALLOCTRACK
+    I_AllocPhaseEnd(phase);
+#endif
+
+#ifdef __linux__
+    if (!perfcounting)
+    {
+        return;
+    }
+
+    info = &perfphases[phase];
+
+    I_ReadPerfCounters(values, &enabled, &running);
+    enabled -= info->startenabled;
+    running -= info->startrunning;
+
+    info->calls++;
+
+    // If the group didn't run at all, there is nothing to scale up.
+    if (running == 0)
+    {
+        info->notrunning++;
+        return;
+    }
+
+    scale = 1.0;
+
+    if (running < enabled)
+    {
+        scale = (double) enabled / running;
+        perfmultiplexed = true;
+    }
+
+    for (i = 0; i < NUMPERFCOUNTERS; ++i)
+    {
+        info->total[i] += (uint64_t) ((values[i] - info->start[i]) * scale);
+    }
+
+    info->pixels += pixels;
+#endif
+}
+
+const char *I_PerfPhaseName (perfphase_t phase)
+{
+    return perfphases[phase].name;
+}
+
+// Print a column of the report, or "-" if the counters needed for it
+// aren't there.
+static void I_PrintPerfColumn (double value, boolean valid)
+{
+    if (valid)
+    {
+        printf(" %10.3f", value);
+    }
+    else
+    {
+        printf(" %10s", "-");
+    }
+}
+
+void I_PrintPerfCounters (void)
+{
+    perfphaseinfo_t*	info;
+    boolean		have[NUMPERFCOUNTERS];
+    boolean		any;
+    boolean		ran;
+    int			i;
+    int			j;
+
+    any = false;
+
+    for (i = 0; i < NUMPERFPHASES; ++i)
+    {
+        any = any || perfphases[i].calls > 0;
+    }
+
+    if (!perfcounting || !any)
+    {
+        return;
+    }
+
+    printf("Performance counters:\n");
+    printf("  %-20s %8s %10s %10s %10s %10s %10s\n", "phase", "calls",
+           "Mcycles", "IPC", "L1d/px", "LLC/px", "br MPKI");
+
+    for (i = 0; i < NUMPERFPHASES; ++i)
+    {
+        info = &perfphases[i];
+
+        if (info->calls == 0)
+        {
+            continue;
+        }
+
+        printf("  %-20s %8i", info->name, info->calls);
+
+        // If the counters never ran, every count is a zero.
+        ran = info->calls > info->notrunning;
+
+        for (j = 0; j < NUMPERFCOUNTERS; ++j)
+        {
+            have[j] = perfslots[j] >= 0 && ran;
+        }
+
+        I_PrintPerfColumn(info->total[PERFC_CYCLES] / 1000000.0,
+                          have[PERFC_CYCLES]);
+        I_PrintPerfColumn((double) info->total[PERFC_INSTRUCTIONS]
+                        / info->total[PERFC_CYCLES],
+                          have[PERFC_CYCLES] && have[PERFC_INSTRUCTIONS]
+                       && info->total[PERFC_CYCLES] > 0);
+        I_PrintPerfColumn((double) info->total[PERFC_L1DMISSES]
+                        / info->pixels,
+                          have[PERFC_L1DMISSES] && info->pixels > 0);
+        I_PrintPerfColumn((double) info->total[PERFC_LLCMISSES]
+                        / info->pixels,
+                          have[PERFC_LLCMISSES] && info->pixels > 0);
+        I_PrintPerfColumn(info->total[PERFC_BRANCHMISSES] * 1000.0
+                        / info->total[PERFC_INSTRUCTIONS],
+                          have[PERFC_BRANCHMISSES]
+                       && have[PERFC_INSTRUCTIONS]
+                       && info->total[PERFC_INSTRUCTIONS] > 0);
+        printf("\n");
+
+        if (info->notrunning > 0)
+        {
+            printf("  %-20s counters didn't run in %i of %i calls, "
+                   "which are left out\n", "", info->notrunning,
+                   info->calls);
+        }
+
+        memset(info->total, 0, sizeof(info->total));
+        info->calls = 0;
+        info->pixels = 0;
+        info->notrunning = 0;
+    }
+
+    if (perfmultiplexed)
+    {
+        printf("  (counters were shared with other users; counts are "
+               "scaled up from the time they ran, and are estimates)\n");
+        perfmultiplexed = false;
+    }
+}
+
+
+//
+// Energy counters
+//
+
+#define MAXENERGYDOMAINS 4
+
+typedef struct
+{
+    const char*	name;
+    uint64_t	time;		// ns
+    uint64_t	cputime;	// ns
+    uint64_t	energy;		// uJ
+    int		tics;
+    int		frames;
+
+} energyinfo_t;
+
+static energyinfo_t energyinfos[NUMENERGYSTATES] =
+{
+    { "level" },
+    { "menu" },
+    { "paused" },
+    { "other" },
+};
+
+boolean		energycounting;
+
+#ifdef __linux__
+
+// One per CPU package. Their subdomains are part of the package
+// energy and aren't read separately.
+typedef struct
+{
+    int		fd;
+    uint64_t	range;		// the counter wraps around at this
+    uint64_t	last;
+
+} energydomain_t;
+
+static energydomain_t	energydomains[MAXENERGYDOMAINS];
+static int		numenergydomains;
+
+static uint64_t		lastenergytime;
+static uint64_t		lastenergycputime;
+static int		lastenergytic;
+
+static boolean I_ReadSysfsValue (int fd, uint64_t* value)
+{
+    char	buf[32];
+    ssize_t	len;
+
+    len = pread(fd, buf, sizeof(buf) - 1, 0);
+
+    if (len <= 0)
+    {
+        return false;
+    }
+
+    buf[len] = '\0';
+    *value = strtoull(buf, NULL, 10);
+
+    return true;
+}
+
+static uint64_t I_GetCPUTimeNS (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Returns false if there is no such package.
+static boolean I_OpenEnergyDomain (int package)
+{
+    energydomain_t*	domain;
+    char		path[64];
+    int			fd;
+    boolean		ok;
+
+    domain = &energydomains[numenergydomains];
+
+    M_snprintf(path, sizeof(path),
+               "/sys/class/powercap/intel-rapl:%i/max_energy_range_uj",
+               package);
+    fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    ok = I_ReadSysfsValue(fd, &domain->range);
+    close(fd);
+
+    M_snprintf(path, sizeof(path),
+               "/sys/class/powercap/intel-rapl:%i/energy_uj", package);
+    domain->fd = open(path, O_RDONLY);
+
+    if (domain->fd < 0 || !ok || !I_ReadSysfsValue(domain->fd, &domain->last))
+    {
+        printf("I_InitEnergy: Can't read %s: %s\n", path,
+               domain->fd < 0 ? strerror(errno) : "invalid value");
+
+        if (domain->fd >= 0)
+        {
+            close(domain->fd);
+        }
+
+        return true;
+    }
+
+    ++numenergydomains;
+
+    return true;
+}
+
+#endif
+
+void I_InitEnergy (void)
+{
+#ifdef __linux__
+    int i;
+#endif
+
+    //!
+    // @category obscure
+    //
+    // Measure the energy used by the CPU with its RAPL counters, and
+    // print energy per tic and per frame, and the average power, for
+    // playing, menus, pausing and everything else. Usually needs to
+    // run as root.
+    //
+
+    if (!M_CheckParm("-energy"))
+    {
+        return;
+    }
+
+#ifdef __linux__
+    numenergydomains = 0;
+
+    for (i = 0; i < MAXENERGYDOMAINS; ++i)
+    {
+        if (!I_OpenEnergyDomain(i))
+        {
+            break;
+        }
+    }
+
+    if (numenergydomains == 0)
+    {
+        printf("I_InitEnergy: No RAPL energy counters available.\n");
+        return;
+    }
+
+    lastenergytime = I_GetTimeNS();
+    lastenergycputime = I_GetCPUTimeNS();
+    lastenergytic = 0;
+
+    energycounting = true;
+    I_AtExit(I_PrintEnergy, true);
+#else
+    printf("I_InitEnergy: Energy counters are only supported on Linux.\n");
+#endif
+}
+
+void I_EnergySample (energystate_t state, int tic, boolean drawn)
+{
+#ifdef __linux__
+    energyinfo_t*	info;
+    energydomain_t*	domain;
+    uint64_t		now;
+    uint64_t		cpunow;
+    uint64_t		value;
+    int			i;
+
+    if (!energycounting)
+    {
+        return;
+    }
+
+    now = I_GetTimeNS();
+    cpunow = I_GetCPUTimeNS();
+
+    info = &energyinfos[state];
+
+    for (i = 0; i < numenergydomains; ++i)
+    {
+        domain = &energydomains[i];
+
+        if (!I_ReadSysfsValue(domain->fd, &value))
+        {
+            continue;
+        }
+
+        if (value >= domain->last)
+        {
+            info->energy += value - domain->last;
+        }
+        else
+        {
+            info->energy += value + domain->range - domain->last;
+        }
+
+        domain->last = value;
+    }
+
+    info->time += now - lastenergytime;
+    info->cputime += cpunow - lastenergycputime;
+    info->tics += tic - lastenergytic;
+    info->frames += drawn;
+
+    lastenergytime = now;
+    lastenergycputime = cpunow;
+    lastenergytic = tic;
+#endif
+}
+
+void I_PrintEnergy (void)
+{
+    energyinfo_t*	info;
+    boolean		any;
+    int			i;
+
+    any = false;
+
+    for (i = 0; i < NUMENERGYSTATES; ++i)
+    {
+        any = any || energyinfos[i].time > 0;
+    }
+
+    if (!energycounting || !any)
+    {
+        return;
+    }
+
+    printf("Energy:\n");
+    printf("  %-8s %10s %10s %8s %8s %10s %10s %10s %10s\n", "state",
+           "seconds", "CPU s", "tics", "frames", "joules", "watts",
+           "mJ/tic", "mJ/frame");
+
+    for (i = 0; i < NUMENERGYSTATES; ++i)
+    {
+        info = &energyinfos[i];
+
+        if (info->time == 0)
+        {
+            continue;
+        }
+
+        printf("  %-8s %10.3f %10.3f %8i %8i %10.3f", info->name,
+               info->time / 1e9, info->cputime / 1e9,
+               info->tics, info->frames, info->energy / 1e6);
+        I_PrintPerfColumn(info->energy * 1000.0 / info->time, true);
+        I_PrintPerfColumn(info->energy / 1000.0 / info->tics,
+                          info->tics > 0);
+        I_PrintPerfColumn(info->energy / 1000.0 / info->frames,
+                          info->frames > 0);
+        printf("\n");
+
+        info->time = 0;
+        info->cputime = 0;
+        info->energy = 0;
+        info->tics = 0;
+        info->frames = 0;
+    }
+}
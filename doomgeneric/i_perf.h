@@ -0,0 +1,80 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Hardware performance and energy counters, for profiling
+//
+
+
+#ifndef __I_PERF__
+#define __I_PERF__
+
+#include "doomtype.h"
+
+// Parts of a frame that are measured separately. These can nest;
+// each one counts everything that happens until it ends.
+typedef enum
+{
+    PERF_TICKER,
+    PERF_BSP,
+    PERF_PLANES,
+    PERF_MASKED,
+    PERF_FINISHUPDATE,
+    PERF_DRAWFRAME,
+    NUMPERFPHASES
+
+} perfphase_t;
+
+// set by -perfcounters, if the counters could be opened
+extern boolean perfcounting;
+
+// Open the counters if -perfcounters was given.
+void I_InitPerfCounters (void);
+
+// Start and stop counting a phase. `pixels` is the number of pixels
+// the phase worked on, for the per pixel figures in the report.
+void I_PerfBegin (perfphase_t phase);
+void I_PerfEnd (perfphase_t phase, int pixels);
+
+// Print what has been counted so far, and start over.
+void I_PrintPerfCounters (void);
+
+const char *I_PerfPhaseName (perfphase_t phase);
+
+// What the game is doing, for the energy report
+typedef enum
+{
+    ENERGY_LEVEL,
+    ENERGY_MENU,
+    ENERGY_PAUSED,
+    ENERGY_OTHER,
+    NUMENERGYSTATES
+
+} energystate_t;
+
+// set by -energy, if the RAPL energy counters could be read
+extern boolean energycounting;
+
+// Find the energy counters if -energy was given.
+void I_InitEnergy (void);
+
+// Called once per frame of the main loop. The time and energy since
+// the last call are accounted to `state`, along with the tics run
+// since then (from `tic`) and whether a frame was drawn.
+void I_EnergySample (energystate_t state, int tic, boolean drawn);
+
+// Print the energy used so far, and start over.
+void I_PrintEnergy (void);
+
+#endif
+
@@ -22,6 +22,7 @@
 #include "doomgeneric.h"
 
 #include <stdarg.h>
+#include <time.h>
 
 //#include <sys/time.h>
 //#include <unistd.h>
@@ -71,6 +72,24 @@ int I_GetTimeMS(void)
     return ticks - basetime;
 }
 
+//
+// Returns time in nanoseconds, at the best resolution available.
+// Only meant for profiling; the base is arbitrary.
+//
+
+uint64_t I_GetTimeNS(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return (uint64_t) I_GetTicks() * 1000000;
+#endif
+}
+
 // Sleep for a specified number of ms
 
 void I_Sleep(int ms)
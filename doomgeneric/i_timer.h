@@ -20,6 +20,8 @@
 #ifndef __I_TIMER__
 #define __I_TIMER__
 
+#include "doomtype.h"
+
 #define TICRATE 35
 
 // Called by D_DoomLoop,
@@ -29,6 +31,9 @@ int I_GetTime (void);
 // returns current time in ms
 int I_GetTimeMS (void);
 
+// returns a high resolution timestamp in ns, for profiling
+uint64_t I_GetTimeNS (void);
+
 // Pause for a specified number of ms
 void I_Sleep(int ms);
 
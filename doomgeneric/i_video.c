@@ -29,7 +29,12 @@ rcsid[] = "$Id: i_x.c,v 1.6 1997/02/03 22:45:10 b1 Exp $";
 #include "v_video.h"
 #include "m_argv.h"
 #include "d_event.h"
+#include "d_loop.h"
 #include "d_main.h"
+#include "doomstat.h"
+#include "i_perf.h"
+#include "i_system.h"
+#include "i_timer.h"
 #include "i_video.h"
 #include "z_zone.h"
 
@@ -40,6 +45,7 @@ rcsid[] = "$Id: i_x.c,v 1.6 1997/02/03 22:45:10 b1 Exp $";
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <fcntl.h>
 
@@ -47,6 +53,14 @@ rcsid[] = "$Id: i_x.c,v 1.6 1997/02/03 22:45:10 b1 Exp $";
 
 #include <sys/types.h>
 
+// The -frametap shared memory export needs POSIX shared memory.
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+#define FRAMETAP
+#include <sys/mman.h>
+#include <unistd.h>
+#include "i_frametap.h"
+#endif
+
 //#define CMAP256
 
 struct FB_BitField
@@ -179,6 +193,128 @@ void cmap_to_fb(uint8_t * out, uint8_t * in, int in_pixels)
     }
 }
 
+#ifdef FRAMETAP
+
+static frametap_t *frametap = NULL;
+static char *frametapname;
+static uint32_t frametapframes;
+
+// Time spent updating the tap, for the report at exit
+static uint64_t frametaptime;
+
+static void I_ShutdownFrameTap(void)
+{
+    munmap(frametap, sizeof(*frametap));
+    shm_unlink(frametapname);
+    frametap = NULL;
+
+    if (frametapframes > 0)
+    {
+        printf("I_ShutdownFrameTap: %u frames, %.2f us per frame\n",
+               frametapframes, frametaptime / 1000.0 / frametapframes);
+    }
+}
+
+//
+// I_InitFrameTap
+// Create the shared memory object for -frametap, if requested.
+//
+
+static void I_InitFrameTap(void)
+{
+    int fd;
+    int p;
+
+    //!
+    // @arg <name>
+    // @category obscure
+    //
+    // Export every displayed frame, with its palette, tic and map,
+    // through the named POSIX shared memory object (eg. /abledoom)
+    // for external viewers and recorders like frametapdump.
+    //
+
+    p = M_CheckParmWithArgs("-frametap", 1);
+
+    if (p == 0)
+    {
+        return;
+    }
+
+    frametapname = myargv[p + 1];
+
+    fd = shm_open(frametapname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0 || ftruncate(fd, sizeof(*frametap)) < 0)
+    {
+        I_Error("I_InitFrameTap: Couldn't create %s", frametapname);
+    }
+
+    frametap = mmap(NULL, sizeof(*frametap), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (frametap == MAP_FAILED)
+    {
+        frametap = NULL;
+        I_Error("I_InitFrameTap: Couldn't map %s", frametapname);
+    }
+
+    frametap->width = SCREENWIDTH;
+    frametap->height = SCREENHEIGHT;
+    frametap->numslots = FRAMETAP_SLOTS;
+    frametap->version = FRAMETAP_VERSION;
+
+    // Readers check the magic last, once the rest is valid.
+    __atomic_store_n(&frametap->magic, FRAMETAP_MAGIC, __ATOMIC_RELEASE);
+
+    I_AtExit(I_ShutdownFrameTap, true);
+}
+
+//
+// I_UpdateFrameTap
+// Publish the frame in I_VideoBuffer to the tap.
+//
+
+static void I_UpdateFrameTap(void)
+{
+    frametap_frame_t *slot;
+    uint64_t start;
+    int i;
+
+    start = I_GetTimeNS();
+
+    slot = &frametap->frames[frametapframes % FRAMETAP_SLOTS];
+
+    // Odd sequence: readers will discard what they copy from here on.
+    __atomic_store_n(&slot->sequence, slot->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->frame = frametapframes;
+    slot->tic = gametic;
+    slot->episode = gameepisode;
+    slot->map = gamemap;
+    slot->timestamp = start;
+
+    for (i = 0; i < 256; ++i)
+    {
+        slot->palette[i * 3] = colors[i].r;
+        slot->palette[i * 3 + 1] = colors[i].g;
+        slot->palette[i * 3 + 2] = colors[i].b;
+    }
+
+    memcpy(slot->pixels, I_VideoBuffer, sizeof(slot->pixels));
+
+    __atomic_store_n(&slot->sequence, slot->sequence + 1, __ATOMIC_RELEASE);
+
+    ++frametapframes;
+    __atomic_store_n(&frametap->numframes, frametapframes, __ATOMIC_RELEASE);
+
+    frametaptime += I_GetTimeNS() - start;
+}
+
+#endif  // FRAMETAP
+
 void I_InitGraphics (void)
 {
     int i;
@@ -233,9 +369,14 @@ void I_InitGraphics (void)
 
     /* Allocate screen to draw to */
 	I_VideoBuffer = (byte*)Z_Malloc (SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);  // For DOOM to draw on
+	memset(dirtyrows, 1, sizeof(dirtyrows));
 
 	screenvisible = true;
 
+#ifdef FRAMETAP
+    I_InitFrameTap();
+#endif
+
     extern void I_InitInput(void);
     I_InitInput();
 }
@@ -269,6 +410,8 @@ void I_FinishUpdate (void)
     int x_offset, y_offset, x_offset_end;
     unsigned char *line_in, *line_out;
 
+    I_PerfBegin(PERF_FINISHUPDATE);
+
     /* Offsets in case FB is bigger than DOOM */
     /* 600 = s_Fb heigt, 200 screenheight */
     /* 600 = s_Fb heigt, 200 screenheight */
@@ -282,12 +425,22 @@ void I_FinishUpdate (void)
     line_in  = (unsigned char *) I_VideoBuffer;
     line_out = (unsigned char *) DG_ScreenBuffer;
 
-    y = SCREENHEIGHT;
+    memset(DG_DirtyRows, 0, sizeof(DG_DirtyRows));
 
-    while (y--)
+    for (y = 0; y < SCREENHEIGHT; y++)
     {
         int i;
+
+        // Leave rows that haven't changed alone
+        if (!dirtyrows[y])
+        {
+            line_out += s_Fb.xres * (s_Fb.bits_per_pixel/8) * fb_scaling;
+            line_in += SCREENWIDTH;
+            continue;
+        }
+
         for (i = 0; i < fb_scaling; i++) {
+            DG_DirtyRows[y * fb_scaling + i] = 1;
             line_out += x_offset;
 #ifdef CMAP256
             if (fb_scaling == 1) {
@@ -311,7 +464,20 @@ void I_FinishUpdate (void)
         line_in += SCREENWIDTH;
     }
 
+    memset(dirtyrows, 0, sizeof(dirtyrows));
+
 	DG_DrawFrame();
+
+    V_CaptureFrame();
+
+#ifdef FRAMETAP
+    if (frametap != NULL)
+    {
+        I_UpdateFrameTap();
+    }
+#endif
+
+    I_PerfEnd(PERF_FINISHUPDATE, SCREENWIDTH * SCREENHEIGHT);
 }
 
 //
@@ -350,6 +516,11 @@ void I_SetPalette (byte* palette)
     /* performance boost:
      * map to the right pixel format over here! */
 
+    V_CapturePalette(palette);
+
+    // Every pixel on screen changes color
+    memset(dirtyrows, 1, sizeof(dirtyrows));
+
     for (i=0; i<256; ++i ) {
         colors[i].a = 0;
         colors[i].r = gammatable[usegamma][*palette++];
@@ -0,0 +1,786 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Network client code.
+//
+//     Local ticcmds are sent to the server as soon as they are built,
+//     together with every earlier one the server has not acknowledged.
+//     Full tics from the server are passed on to d_loop.c through
+//     D_ReceiveTic.  Round trip time, jitter, loss and tic buffer
+//     statistics are printed on exit, and periodically with -netstats.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomtype.h"
+#include "d_loop.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_config.h"
+#include "m_misc.h"
+#include "net_client.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_server.h"
+#include "net_structrw.h"
+
+#define KEEPALIVE_INTERVAL  250
+#define GAMESTART_INTERVAL  500
+#define RESEND_INTERVAL     50
+#define SERVER_TIMEOUT      10000
+#define STATS_INTERVAL      10000
+
+typedef enum
+{
+    CLIENT_STATE_WAITING_LAUNCH,
+    CLIENT_STATE_WAITING_START,
+    CLIENT_STATE_IN_GAME,
+} net_clientstate_t;
+
+// Client statistics.  Loss is counted from gaps in the server's packet
+// sequence numbers; redundant tics are ones which had already arrived
+// in an earlier packet.
+
+typedef struct
+{
+    int packets_sent;
+    int packets_received;
+    int packets_lost;
+    int tics_received;
+    int tics_redundant;
+    int rtt_min;
+    int rtt_max;
+    int rtt_total;
+    int rtt_count;
+    int jitter;             // RFC 3550 interarrival jitter, 1/16 ms
+    int last_transit;
+    int buffer_total;
+    int buffer_count;
+    int buffer_max;
+} net_clientstats_t;
+
+boolean net_client_connected;
+boolean net_client_received_wait_data;
+net_waitdata_t net_client_wait_data;
+boolean net_waiting_for_launch = false;
+char *net_player_name = NULL;
+
+sha1_digest_t net_server_wad_sha1sum;
+sha1_digest_t net_server_deh_sha1sum;
+unsigned int net_server_is_freedoom;
+sha1_digest_t net_local_wad_sha1sum;
+sha1_digest_t net_local_deh_sha1sum;
+unsigned int net_local_is_freedoom;
+
+// Running as a drone: we receive tics but do not send any
+
+boolean drone = false;
+
+static net_clientstate_t client_state;
+static net_context_t *client_context;
+static net_addr_t *server_addr;
+
+static net_gamesettings_t settings;
+static boolean received_settings;
+static boolean start_requested;
+
+// Local ticcmds by tic, and how many the server has acknowledged
+
+static ticcmd_t send_queue[BACKUPTICS];
+static int sendtic;
+static int send_acked;
+
+// Number of full tics received from the server; acknowledged in
+// every packet we send.
+
+static int recvtic;
+static boolean need_ack;
+
+static unsigned int send_seq;
+static int recv_seq;
+
+static int last_send_time;
+static int last_recv_time;
+static int last_gamestart_time;
+
+static int peer_time;
+static int peer_time_recv;
+
+static boolean print_stats;
+static int last_stats_time;
+static net_clientstats_t stats;
+
+static net_packet_t *NET_CL_NewPacket(net_packet_type_t type)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, type);
+
+    return packet;
+}
+
+static void NET_CL_SendPacket(net_packet_t *packet)
+{
+    NET_SendPacket(server_addr, packet);
+    NET_FreePacket(packet);
+
+    last_send_time = I_GetTimeMS();
+    ++stats.packets_sent;
+}
+
+static void NET_CL_WriteTimes(net_packet_t *packet)
+{
+    int nowtime = I_GetTimeMS();
+
+    NET_WriteInt32(packet, nowtime);
+    NET_WriteInt32(packet, peer_time);
+    NET_WriteInt32(packet, peer_time_recv < 0 ? -1 :
+                           nowtime - peer_time_recv);
+}
+
+static boolean NET_CL_ReadTimes(net_packet_t *packet)
+{
+    unsigned int sendtime, echotime;
+    signed int holdtime;
+    int nowtime, rtt, transit, d;
+
+    if (!NET_ReadInt32(packet, &sendtime)
+     || !NET_ReadInt32(packet, &echotime)
+     || !NET_ReadSInt32(packet, &holdtime))
+    {
+        return false;
+    }
+
+    nowtime = I_GetTimeMS();
+
+    peer_time = sendtime;
+    peer_time_recv = nowtime;
+
+    if (holdtime >= 0)
+    {
+        rtt = nowtime - (int) echotime - holdtime;
+
+        if (rtt >= 0)
+        {
+            if (stats.rtt_count == 0 || rtt < stats.rtt_min)
+                stats.rtt_min = rtt;
+            if (rtt > stats.rtt_max)
+                stats.rtt_max = rtt;
+
+            stats.rtt_total += rtt;
+            ++stats.rtt_count;
+        }
+    }
+
+    // The server clock offset cancels out of the transit difference.
+
+    transit = nowtime - (int) sendtime;
+
+    if (stats.packets_received > 0)
+    {
+        d = transit - stats.last_transit;
+
+        if (d < 0)
+            d = -d;
+
+        stats.jitter += d - ((stats.jitter + 8) >> 4);
+    }
+
+    stats.last_transit = transit;
+
+    return true;
+}
+
+static void NET_CL_PrintStats(void)
+{
+    if (stats.packets_received == 0)
+    {
+        return;
+    }
+
+    printf("NET_CL: %i packets sent, %i received, %i lost (%i.%i%%)\n",
+           stats.packets_sent, stats.packets_received, stats.packets_lost,
+           stats.packets_lost * 100
+               / (stats.packets_received + stats.packets_lost),
+           stats.packets_lost * 1000
+               / (stats.packets_received + stats.packets_lost) % 10);
+    printf("NET_CL: %i tics received, %i redundant copies\n",
+           stats.tics_received, stats.tics_redundant);
+
+    if (stats.rtt_count > 0)
+    {
+        printf("NET_CL: rtt min %ims, avg %ims, max %ims, "
+               "jitter %ims\n",
+               stats.rtt_min, stats.rtt_total / stats.rtt_count,
+               stats.rtt_max, stats.jitter >> 4);
+    }
+
+    if (stats.buffer_count > 0)
+    {
+        printf("NET_CL: tic buffer avg %i.%i, max %i (ticdup %i)\n",
+               stats.buffer_total / stats.buffer_count,
+               stats.buffer_total * 10 / stats.buffer_count % 10,
+               stats.buffer_max, ticdup);
+    }
+}
+
+// Send our ticcmds that the server has not acknowledged, and
+// acknowledge the full tics we have received.
+
+static void NET_CL_SendTics(void)
+{
+    net_ticdiff_t diff;
+    net_packet_t *packet;
+    ticcmd_t prev;
+    int starttic, count;
+    int i;
+
+    starttic = send_acked;
+    count = sendtic - starttic;
+
+    if (count > NET_MAXTICSPERPACKET)
+    {
+        count = NET_MAXTICSPERPACKET;
+    }
+
+    packet = NET_CL_NewPacket(NET_PACKET_TYPE_GAMEDATA);
+    NET_WriteInt16(packet, send_seq++ & 0xffff);
+    NET_CL_WriteTimes(packet);
+    NET_WriteInt32(packet, recvtic);
+    NET_WriteInt32(packet, starttic);
+    NET_WriteInt8(packet, count);
+
+    memset(&prev, 0, sizeof(prev));
+
+    for (i = starttic; i < starttic + count; ++i)
+    {
+        NET_TiccmdDiff(&prev, &send_queue[i % BACKUPTICS], &diff);
+        NET_WriteTiccmdDiff(packet, &diff, settings.lowres_turn);
+        prev = send_queue[i % BACKUPTICS];
+    }
+
+    NET_CL_SendPacket(packet);
+
+    need_ack = false;
+}
+
+static void NET_CL_Disconnected(void)
+{
+    boolean in_game;
+
+    in_game = client_state == CLIENT_STATE_IN_GAME;
+
+    net_client_connected = false;
+    net_waiting_for_launch = false;
+
+    if (in_game)
+    {
+        D_ReceiveTic(NULL, NULL);
+    }
+}
+
+static void NET_CL_ParseWaitingData(net_packet_t *packet)
+{
+    net_waitdata_t wait_data;
+
+    if (!NET_ReadWaitData(packet, &wait_data)
+     || !NET_CL_ReadTimes(packet))
+    {
+        return;
+    }
+
+    memcpy(&net_client_wait_data, &wait_data, sizeof(net_waitdata_t));
+    memcpy(net_server_wad_sha1sum, wait_data.wad_sha1sum,
+           sizeof(sha1_digest_t));
+    memcpy(net_server_deh_sha1sum, wait_data.deh_sha1sum,
+           sizeof(sha1_digest_t));
+    net_server_is_freedoom = wait_data.is_freedoom;
+    net_client_received_wait_data = true;
+}
+
+static void NET_CL_ParseLaunch(net_packet_t *packet)
+{
+    if (client_state == CLIENT_STATE_WAITING_LAUNCH)
+    {
+        client_state = CLIENT_STATE_WAITING_START;
+        net_waiting_for_launch = false;
+    }
+}
+
+// The server resends the game start message if we keep sending
+// keepalives after it started the game, so this also covers a lost
+// launch message.
+
+static void NET_CL_ParseGameStart(net_packet_t *packet)
+{
+    if (client_state == CLIENT_STATE_IN_GAME
+     || !NET_ReadSettings(packet, &settings))
+    {
+        return;
+    }
+
+    if (settings.num_players > NET_MAXPLAYERS
+     || settings.consoleplayer >= settings.num_players)
+    {
+        fprintf(stderr, "NET_CL_ParseGameStart: Invalid settings\n");
+        return;
+    }
+
+    client_state = CLIENT_STATE_IN_GAME;
+    net_waiting_for_launch = false;
+    received_settings = true;
+
+    sendtic = 0;
+    send_acked = 0;
+    recvtic = 0;
+}
+
+static void NET_CL_ParseGameData(net_packet_t *packet)
+{
+    ticcmd_t cmds[NET_MAXPLAYERS];
+    boolean ingame[NET_MAXPLAYERS];
+    net_ticdiff_t diff;
+    unsigned int seq, cmdack, starttic, count, ingame_bits;
+    unsigned int i, p;
+    int localplayer;
+    int gap;
+
+    // Tics are only passed on once d_loop.c has started the game.
+
+    if (client_state != CLIENT_STATE_IN_GAME || !start_requested
+     || !NET_ReadInt16(packet, &seq)
+     || !NET_CL_ReadTimes(packet)
+     || !NET_ReadInt32(packet, &cmdack)
+     || !NET_ReadInt32(packet, &starttic)
+     || !NET_ReadInt8(packet, &count))
+    {
+        return;
+    }
+
+    ++stats.packets_received;
+
+    if (recv_seq >= 0)
+    {
+        gap = (seq - recv_seq) & 0xffff;
+
+        // Ignore late packets which were overtaken by newer ones.
+
+        if (gap != 0 && gap < 0x8000)
+        {
+            stats.packets_lost += gap - 1;
+            recv_seq = seq;
+        }
+    }
+    else
+    {
+        recv_seq = seq;
+    }
+
+    if ((int) cmdack > send_acked && (int) cmdack <= sendtic)
+    {
+        send_acked = cmdack;
+    }
+
+    localplayer = drone ? -1 : settings.consoleplayer;
+
+    memset(cmds, 0, sizeof(cmds));
+
+    for (i = 0; i < count; ++i)
+    {
+        if (!NET_ReadInt8(packet, &ingame_bits))
+        {
+            return;
+        }
+
+        for (p = 0; p < NET_MAXPLAYERS; ++p)
+        {
+            ingame[p] = (ingame_bits & (1 << p)) != 0;
+
+            if (ingame[p] && p != localplayer)
+            {
+                if (!NET_ReadTiccmdDiff(packet, &diff, settings.lowres_turn))
+                {
+                    return;
+                }
+
+                NET_TiccmdPatch(&cmds[p], &diff, &cmds[p]);
+            }
+        }
+
+        if (starttic + i < recvtic)
+        {
+            ++stats.tics_redundant;
+        }
+        else if (starttic + i == recvtic)
+        {
+            D_ReceiveTic(cmds, ingame);
+            ++recvtic;
+            ++stats.tics_received;
+            need_ack = true;
+        }
+    }
+}
+
+static void NET_CL_ParsePacket(net_packet_t *packet)
+{
+    unsigned int packet_type;
+
+    if (!NET_ReadInt16(packet, &packet_type))
+    {
+        return;
+    }
+
+    last_recv_time = I_GetTimeMS();
+
+    switch (packet_type)
+    {
+        case NET_PACKET_TYPE_WAITING_DATA:
+            NET_CL_ParseWaitingData(packet);
+            break;
+        case NET_PACKET_TYPE_LAUNCH:
+            NET_CL_ParseLaunch(packet);
+            break;
+        case NET_PACKET_TYPE_GAMESTART:
+            NET_CL_ParseGameStart(packet);
+            break;
+        case NET_PACKET_TYPE_GAMEDATA:
+            NET_CL_ParseGameData(packet);
+            break;
+        case NET_PACKET_TYPE_DISCONNECT:
+            printf("NET_CL: Server closed the connection\n");
+            NET_CL_Disconnected();
+            break;
+        default:
+            break;
+    }
+}
+
+static void NET_CL_SendKeepalive(void)
+{
+    net_packet_t *packet;
+
+    packet = NET_CL_NewPacket(NET_PACKET_TYPE_KEEPALIVE);
+    NET_CL_WriteTimes(packet);
+    NET_CL_SendPacket(packet);
+}
+
+static void NET_CL_SendGameStart(void)
+{
+    net_packet_t *packet;
+
+    packet = NET_CL_NewPacket(NET_PACKET_TYPE_GAMESTART);
+    NET_WriteSettings(packet, &settings);
+    NET_CL_SendPacket(packet);
+
+    last_gamestart_time = I_GetTimeMS();
+}
+
+void NET_CL_Run(void)
+{
+    net_addr_t *addr;
+    net_packet_t *packet;
+    int nowtime;
+    int depth;
+
+    if (!net_client_connected)
+    {
+        return;
+    }
+
+    while (NET_RecvPacket(client_context, &addr, &packet))
+    {
+        // only accept packets from the server
+
+        if (addr == server_addr)
+        {
+            NET_CL_ParsePacket(packet);
+        }
+
+        NET_FreePacket(packet);
+
+        if (!net_client_connected)
+        {
+            return;
+        }
+    }
+
+    nowtime = I_GetTimeMS();
+
+    if (nowtime - last_recv_time > SERVER_TIMEOUT)
+    {
+        printf("NET_CL: No response from server, disconnecting\n");
+        NET_CL_Disconnected();
+        return;
+    }
+
+    if (client_state != CLIENT_STATE_IN_GAME)
+    {
+        if (start_requested
+         && nowtime - last_gamestart_time >= GAMESTART_INTERVAL)
+        {
+            NET_CL_SendGameStart();
+        }
+        else if (nowtime - last_send_time >= KEEPALIVE_INTERVAL)
+        {
+            NET_CL_SendKeepalive();
+        }
+
+        return;
+    }
+
+    if (((send_acked < sendtic || need_ack)
+      && nowtime - last_send_time >= RESEND_INTERVAL)
+     || nowtime - last_send_time >= 1000)
+    {
+        NET_CL_SendTics();
+    }
+
+    // How far ahead of the game the received tics are
+
+    depth = recvtic - gametic / ticdup;
+
+    if (depth >= 0)
+    {
+        stats.buffer_total += depth;
+        ++stats.buffer_count;
+
+        if (depth > stats.buffer_max)
+        {
+            stats.buffer_max = depth;
+        }
+    }
+
+    if (print_stats && nowtime - last_stats_time >= STATS_INTERVAL)
+    {
+        NET_CL_PrintStats();
+        last_stats_time = nowtime;
+    }
+}
+
+static void NET_CL_SendSYN(net_connect_data_t *data)
+{
+    net_packet_t *packet;
+
+    packet = NET_CL_NewPacket(NET_PACKET_TYPE_SYN);
+    NET_WriteInt32(packet, NET_MAGIC_NUMBER);
+    NET_WriteConnectData(packet, data);
+    NET_WriteString(packet, net_player_name);
+    NET_CL_SendPacket(packet);
+}
+
+// Connect to a server
+
+boolean NET_CL_Connect(net_addr_t *addr, net_connect_data_t *data)
+{
+    net_addr_t *reply_addr;
+    net_packet_t *packet;
+    unsigned int packet_type;
+    char *reject_reason;
+    int start_time;
+    int last_syn_time;
+    boolean accepted;
+
+    server_addr = addr;
+
+    memcpy(net_local_wad_sha1sum, data->wad_sha1sum, sizeof(sha1_digest_t));
+    memcpy(net_local_deh_sha1sum, data->deh_sha1sum, sizeof(sha1_digest_t));
+    net_local_is_freedoom = data->is_freedoom;
+
+    drone = data->drone;
+
+    // create a new network client context
+
+    client_context = NET_NewContext();
+
+    // initialize module for client mode
+
+    if (!addr->module->InitClient())
+    {
+        return false;
+    }
+
+    NET_AddModule(client_context, addr->module);
+
+    memset(&stats, 0, sizeof(stats));
+    recv_seq = -1;
+    peer_time_recv = -1;
+
+    // Resend the SYN every second until the server answers
+
+    start_time = I_GetTimeMS();
+    last_syn_time = -1000;
+    accepted = false;
+
+    while (!accepted && I_GetTimeMS() - start_time < 10000)
+    {
+        if (I_GetTimeMS() - last_syn_time >= 1000)
+        {
+            NET_CL_SendSYN(data);
+            last_syn_time = I_GetTimeMS();
+        }
+
+        while (!accepted
+            && NET_RecvPacket(client_context, &reply_addr, &packet))
+        {
+            if (reply_addr == server_addr
+             && NET_ReadInt16(packet, &packet_type))
+            {
+                if (packet_type == NET_PACKET_TYPE_ACK)
+                {
+                    accepted = true;
+                }
+                else if (packet_type == NET_PACKET_TYPE_REJECTED)
+                {
+                    reject_reason = NET_ReadString(packet);
+
+                    I_Error("NET_CL_Connect: Rejected by server: %s",
+                            reject_reason != NULL ? reject_reason : "");
+                }
+            }
+
+            NET_FreePacket(packet);
+        }
+
+        // run the server, just in case we are doing a loopback
+        // connect
+
+        NET_SV_Run();
+
+        I_Sleep(1);
+    }
+
+    if (!accepted)
+    {
+        return false;
+    }
+
+    net_client_connected = true;
+    net_client_received_wait_data = false;
+    net_waiting_for_launch = true;
+    client_state = CLIENT_STATE_WAITING_LAUNCH;
+    received_settings = false;
+    start_requested = false;
+    last_recv_time = I_GetTimeMS();
+    last_stats_time = last_recv_time;
+
+    I_AtExit(NET_CL_PrintStats, true);
+
+    return true;
+}
+
+// read game settings received from server
+
+boolean NET_CL_GetSettings(net_gamesettings_t *_settings)
+{
+    if (!received_settings)
+    {
+        return false;
+    }
+
+    memcpy(_settings, &settings, sizeof(net_gamesettings_t));
+
+    return true;
+}
+
+// disconnect from the server
+
+void NET_CL_Disconnect(void)
+{
+    net_packet_t *packet;
+    int i;
+
+    if (!net_client_connected)
+    {
+        return;
+    }
+
+    // There is no acknowledgement to wait for while shutting down;
+    // send a few copies and let the server's timeout cover the rest.
+
+    for (i = 0; i < 3; ++i)
+    {
+        packet = NET_CL_NewPacket(NET_PACKET_TYPE_DISCONNECT);
+        NET_CL_SendPacket(packet);
+    }
+
+    net_client_connected = false;
+}
+
+void NET_CL_LaunchGame(void)
+{
+    net_packet_t *packet;
+
+    packet = NET_CL_NewPacket(NET_PACKET_TYPE_LAUNCH);
+    NET_CL_SendPacket(packet);
+}
+
+void NET_CL_StartGame(net_gamesettings_t *gamesettings)
+{
+    start_requested = true;
+
+    if (!received_settings)
+    {
+        settings = *gamesettings;
+        NET_CL_SendGameStart();
+    }
+}
+
+void NET_CL_SendTiccmd(ticcmd_t *ticcmd, int maketic)
+{
+    if (maketic != sendtic || maketic - send_acked >= BACKUPTICS)
+    {
+        return;
+    }
+
+    send_queue[maketic % BACKUPTICS] = *ticcmd;
+    sendtic = maketic + 1;
+
+    NET_CL_SendTics();
+}
+
+void NET_CL_Init(void)
+{
+    // Try to set from the USER and USERNAME environment variables
+    // Otherwise, fallback to "Player"
+
+    if (net_player_name == NULL)
+        net_player_name = getenv("USER");
+    if (net_player_name == NULL)
+        net_player_name = getenv("USERNAME");
+    if (net_player_name == NULL)
+        net_player_name = "Player";
+
+    //!
+    // @category net
+    //
+    // Print network statistics every ten seconds during the game.
+    //
+
+    print_stats = M_CheckParm("-netstats") > 0;
+}
+
+void NET_Init(void)
+{
+    NET_CL_Init();
+}
+
+void NET_BindVariables(void)
+{
+    M_BindVariable("player_name", &net_player_name);
+}
@@ -0,0 +1,35 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Dedicated server code.
+//
+
+#include "doomtype.h"
+#include "i_timer.h"
+#include "net_dedicated.h"
+#include "net_sdl.h"
+#include "net_server.h"
+
+void NET_DedicatedServer(void)
+{
+    NET_SV_Init();
+    NET_SV_AddModule(&net_sdl_module);
+    NET_SV_RegisterWithMaster();
+
+    for (;;)
+    {
+        NET_SV_Run();
+        I_Sleep(1);
+    }
+}
@@ -44,6 +44,12 @@
 
 #define BACKUPTICS 128
 
+// Maximum number of tics carried in one game data packet.  Every packet
+// repeats all tics the peer has not acknowledged yet, up to this limit,
+// so that a lost packet is covered by the next one.
+
+#define NET_MAXTICSPERPACKET 16
+
 typedef struct _net_module_s net_module_t;
 typedef struct _net_packet_s net_packet_t;
 typedef struct _net_addr_s net_addr_t;
@@ -0,0 +1,89 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Waiting for the game to launch.  There is no graphical waiting
+//     screen; the player list is printed to the console when it
+//     changes, and the server launches the game once enough players
+//     have joined.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "net_client.h"
+#include "net_gui.h"
+#include "net_server.h"
+
+static void PrintWaitData(net_waitdata_t *wait_data)
+{
+    int i;
+
+    printf("NET_WaitForLaunch: %i of %i players%s:\n",
+           wait_data->num_players, wait_data->max_players,
+           wait_data->is_controller ? " (you are the controller)" : "");
+
+    for (i = 0; i < wait_data->num_players; ++i)
+    {
+        printf("    %i: %-16s %s%s\n", i + 1,
+               wait_data->player_names[i], wait_data->player_addrs[i],
+               i == wait_data->consoleplayer ? " (you)" : "");
+    }
+
+    if (wait_data->num_drones > 0)
+    {
+        printf("    plus %i observer(s)\n", wait_data->num_drones);
+    }
+
+    if (memcmp(net_local_wad_sha1sum, wait_data->wad_sha1sum,
+               sizeof(sha1_digest_t)) != 0)
+    {
+        printf("NET_WaitForLaunch: Warning: your WAD directory does not "
+               "match the controller's.\n");
+    }
+}
+
+void NET_WaitForLaunch(void)
+{
+    net_waitdata_t last_wait_data;
+
+    memset(&last_wait_data, 0, sizeof(last_wait_data));
+
+    while (net_waiting_for_launch)
+    {
+        NET_CL_Run();
+        NET_SV_Run();
+
+        if (!net_client_connected)
+        {
+            I_Error("Lost connection to server");
+        }
+
+        if (net_client_received_wait_data
+         && memcmp(&last_wait_data, &net_client_wait_data,
+                   sizeof(net_waitdata_t)) != 0)
+        {
+            PrintWaitData(&net_client_wait_data);
+            memcpy(&last_wait_data, &net_client_wait_data,
+                   sizeof(net_waitdata_t));
+        }
+
+        // Poll often: the server measures round trip times while
+        // waiting, and a long sleep here would inflate them.
+
+        I_Sleep(5);
+    }
+}
@@ -0,0 +1,209 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Querying servers to find their current status.
+//
+//     Servers are found by broadcasting on the local network or by
+//     address; there is no master server support.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_query.h"
+#include "net_sdl.h"
+#include "net_structrw.h"
+
+// How long to wait for servers to respond to a query
+
+#define QUERY_TIMEOUT 2000
+
+static net_context_t *query_context;
+static net_addr_t *query_addr;
+static int query_start_time;
+
+static void NET_Query_Init(void)
+{
+    if (query_context == NULL)
+    {
+        query_context = NET_NewContext();
+        NET_AddModule(query_context, &net_sdl_module);
+        net_sdl_module.InitClient();
+    }
+}
+
+static void NET_Query_SendQuery(net_addr_t *addr)
+{
+    net_packet_t *request;
+
+    request = NET_NewPacket(10);
+    NET_WriteInt16(request, NET_PACKET_TYPE_QUERY);
+
+    if (addr == NULL)
+    {
+        NET_SendBroadcast(query_context, request);
+    }
+    else
+    {
+        NET_SendPacket(addr, request);
+    }
+
+    NET_FreePacket(request);
+
+    query_start_time = I_GetTimeMS();
+}
+
+int NET_StartLANQuery(void)
+{
+    NET_Query_Init();
+    query_addr = NULL;
+    NET_Query_SendQuery(NULL);
+
+    return 1;
+}
+
+int NET_StartMasterQuery(void)
+{
+    return 0;
+}
+
+// Process responses to the current query, invoking the callback for
+// each.  Returns true while still waiting for responses.
+
+int NET_Query_Poll(net_query_callback_t callback, void *user_data)
+{
+    net_querydata_t querydata;
+    net_addr_t *addr;
+    net_packet_t *packet;
+    unsigned int packet_type;
+
+    while (NET_RecvPacket(query_context, &addr, &packet))
+    {
+        if ((query_addr == NULL || addr == query_addr)
+         && NET_ReadInt16(packet, &packet_type)
+         && packet_type == NET_PACKET_TYPE_QUERY_RESPONSE
+         && NET_ReadQueryData(packet, &querydata))
+        {
+            callback(addr, &querydata, I_GetTimeMS() - query_start_time,
+                     user_data);
+        }
+
+        NET_FreePacket(packet);
+    }
+
+    return I_GetTimeMS() - query_start_time < QUERY_TIMEOUT;
+}
+
+static void PrintResponse(net_addr_t *addr, net_querydata_t *querydata,
+                          unsigned int ping_time, void *user_data)
+{
+    printf("%-21s %4ims  %i/%i  %s  %s\n",
+           NET_AddrToString(addr), ping_time,
+           querydata->num_players, querydata->max_players,
+           querydata->server_state ? "in game" : "waiting",
+           querydata->description);
+
+    if (user_data != NULL)
+    {
+        ++*((int *) user_data);
+    }
+}
+
+static void FindFirstResponse(net_addr_t *addr, net_querydata_t *querydata,
+                              unsigned int ping_time, void *user_data)
+{
+    net_addr_t **result = user_data;
+
+    if (*result == NULL && querydata->server_state == 0)
+    {
+        *result = addr;
+    }
+}
+
+void NET_LANQuery(void)
+{
+    int found = 0;
+
+    printf("Searching for servers on the local network...\n\n");
+
+    NET_StartLANQuery();
+
+    while (NET_Query_Poll(PrintResponse, &found))
+    {
+        I_Sleep(10);
+    }
+
+    if (found == 0)
+    {
+        printf("No servers found.\n");
+    }
+}
+
+void NET_MasterQuery(void)
+{
+    printf("Master server queries are not supported; "
+           "use -localsearch instead.\n");
+}
+
+void NET_QueryAddress(char *addr)
+{
+    int found = 0;
+
+    NET_Query_Init();
+
+    query_addr = net_sdl_module.ResolveAddress(addr);
+
+    if (query_addr == NULL)
+    {
+        I_Error("NET_QueryAddress: Host '%s' not found!", addr);
+    }
+
+    printf("\nQuerying '%s'...\n", addr);
+
+    NET_Query_SendQuery(query_addr);
+
+    while (found == 0 && NET_Query_Poll(PrintResponse, &found))
+    {
+        I_Sleep(10);
+    }
+
+    if (found == 0)
+    {
+        I_Error("No response from '%s'", addr);
+    }
+}
+
+// Returns the first server on the local network that is still waiting
+// for players, or NULL if none answered.
+
+net_addr_t *NET_FindLANServer(void)
+{
+    net_addr_t *result = NULL;
+
+    NET_StartLANQuery();
+
+    while (result == NULL && NET_Query_Poll(FindFirstResponse, &result))
+    {
+        I_Sleep(10);
+    }
+
+    return result;
+}
@@ -0,0 +1,396 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Networking module which uses BSD sockets for UDP transport.
+//     Keeps the name of the SDL_net module it replaces, so that
+//     d_loop.c and the server can refer to it unchanged.
+//
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_sdl.h"
+#include "z_zone.h"
+
+#define DEFAULT_PORT 2342
+
+// Largest datagram we ever expect; the tic packets are far smaller.
+
+#define MAX_DATAGRAM 1500
+
+static boolean initted = false;
+static int port = DEFAULT_PORT;
+static int udpsocket = -1;
+
+// Percentage of outgoing packets to drop, for testing loss tolerance.
+
+static int netloss = 0;
+
+// Addresses are handed out once per peer and reused, so that the
+// client and server can compare net_addr_t pointers directly.
+
+typedef struct
+{
+    net_addr_t net_addr;
+    struct sockaddr_in sa;
+} addrpair_t;
+
+static addrpair_t **addr_table;
+static int addr_table_size = -1;
+
+static void NET_SDL_InitAddrTable(void)
+{
+    addr_table_size = 16;
+
+    addr_table = Z_Malloc(sizeof(addrpair_t *) * addr_table_size,
+                          PU_STATIC, 0);
+    memset(addr_table, 0, sizeof(addrpair_t *) * addr_table_size);
+}
+
+static boolean AddressesEqual(struct sockaddr_in *a, struct sockaddr_in *b)
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr
+        && a->sin_port == b->sin_port;
+}
+
+// Finds an address by searching the table.  If the address is not
+// found, it is added to the table.
+
+static net_addr_t *NET_SDL_FindAddress(struct sockaddr_in *addr)
+{
+    addrpair_t *new_entry;
+    int empty_entry = -1;
+    int i;
+
+    if (addr_table_size < 0)
+    {
+        NET_SDL_InitAddrTable();
+    }
+
+    for (i=0; i<addr_table_size; ++i)
+    {
+        if (addr_table[i] != NULL
+         && AddressesEqual(addr, &addr_table[i]->sa))
+        {
+            return &addr_table[i]->net_addr;
+        }
+
+        if (empty_entry < 0 && addr_table[i] == NULL)
+            empty_entry = i;
+    }
+
+    // Was not found in list.  We need to add it.
+
+    // Is there any space in the table? If not, increase the table size
+
+    if (empty_entry < 0)
+    {
+        addrpair_t **new_addr_table;
+        int new_addr_table_size;
+
+        // after reallocing, we will add this in as the first entry
+        // in the new block of memory
+
+        empty_entry = addr_table_size;
+
+        // allocate a new array twice the size, init to 0 and copy
+        // the existing table in.  replace the old table.
+
+        new_addr_table_size = addr_table_size * 2;
+        new_addr_table = Z_Malloc(sizeof(addrpair_t *) * new_addr_table_size,
+                                  PU_STATIC, 0);
+        memset(new_addr_table, 0, sizeof(addrpair_t *) * new_addr_table_size);
+        memcpy(new_addr_table, addr_table,
+               sizeof(addrpair_t *) * addr_table_size);
+        Z_Free(addr_table);
+        addr_table = new_addr_table;
+        addr_table_size = new_addr_table_size;
+    }
+
+    // Add a new entry
+
+    new_entry = Z_Malloc(sizeof(addrpair_t), PU_STATIC, 0);
+
+    new_entry->sa = *addr;
+    new_entry->net_addr.handle = &new_entry->sa;
+    new_entry->net_addr.module = &net_sdl_module;
+
+    addr_table[empty_entry] = new_entry;
+
+    return &new_entry->net_addr;
+}
+
+static void NET_SDL_FreeAddress(net_addr_t *addr)
+{
+    int i;
+
+    for (i=0; i<addr_table_size; ++i)
+    {
+        if (addr_table[i] != NULL && addr == &addr_table[i]->net_addr)
+        {
+            Z_Free(addr_table[i]);
+            addr_table[i] = NULL;
+            return;
+        }
+    }
+
+    I_Error("NET_SDL_FreeAddress: Attempted to remove an unused address!");
+}
+
+static boolean NET_SDL_OpenSocket(int bind_port)
+{
+    struct sockaddr_in sa;
+    int one = 1;
+
+    udpsocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    if (udpsocket < 0)
+    {
+        I_Error("NET_SDL_OpenSocket: Unable to open a socket: %s",
+                strerror(errno));
+    }
+
+    // Never block in the game loop; RecvPacket is polled every tic.
+
+    fcntl(udpsocket, F_SETFL, fcntl(udpsocket, F_GETFL, 0) | O_NONBLOCK);
+    setsockopt(udpsocket, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    sa.sin_port = htons(bind_port);
+
+    if (bind(udpsocket, (struct sockaddr *) &sa, sizeof(sa)) < 0)
+    {
+        I_Error("NET_SDL_OpenSocket: Unable to bind to port %i: %s",
+                bind_port, strerror(errno));
+    }
+
+    return true;
+}
+
+static void NET_SDL_CheckParms(void)
+{
+    int p;
+
+    //!
+    // @category net
+    // @arg <n>
+    //
+    // Use the specified UDP port for communications, instead of
+    // the default (2342).
+    //
+
+    p = M_CheckParmWithArgs("-port", 1);
+
+    if (p > 0)
+    {
+        port = atoi(myargv[p+1]);
+    }
+
+    //!
+    // @category net
+    // @arg <percent>
+    //
+    // Drop the given percentage of outgoing packets, to test how
+    // well the game copes with an unreliable network.
+    //
+
+    p = M_CheckParmWithArgs("-netloss", 1);
+
+    if (p > 0)
+    {
+        netloss = atoi(myargv[p+1]);
+        printf("NET_SDL: Dropping %i%% of outgoing packets.\n", netloss);
+    }
+}
+
+static boolean NET_SDL_InitClient(void)
+{
+    if (initted)
+        return true;
+
+    NET_SDL_CheckParms();
+
+    // Clients use an ephemeral port so that several can run on
+    // the same machine as the server.
+
+    NET_SDL_OpenSocket(0);
+    initted = true;
+
+    return true;
+}
+
+static boolean NET_SDL_InitServer(void)
+{
+    if (initted)
+        return true;
+
+    NET_SDL_CheckParms();
+    NET_SDL_OpenSocket(port);
+    initted = true;
+
+    return true;
+}
+
+static void NET_SDL_SendPacket(net_addr_t *addr, net_packet_t *packet)
+{
+    struct sockaddr_in sa;
+
+    if (addr == &net_broadcast_addr)
+    {
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+        sa.sin_port = htons(port);
+    }
+    else
+    {
+        sa = *((struct sockaddr_in *) addr->handle);
+    }
+
+    // Simulated packet loss uses rand() and not M_Random(), which
+    // would desync the game.
+
+    if (netloss > 0 && rand() % 100 < netloss)
+    {
+        return;
+    }
+
+    if (sendto(udpsocket, packet->data, packet->len, 0,
+               (struct sockaddr *) &sa, sizeof(sa)) < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            fprintf(stderr, "NET_SDL_SendPacket: Error transmitting "
+                            "packet: %s\n", strerror(errno));
+        }
+    }
+}
+
+static boolean NET_SDL_RecvPacket(net_addr_t **addr, net_packet_t **packet)
+{
+    static byte buf[MAX_DATAGRAM];
+    struct sockaddr_in sa;
+    socklen_t sa_len;
+    ssize_t result;
+
+    sa_len = sizeof(sa);
+    result = recvfrom(udpsocket, buf, sizeof(buf), 0,
+                      (struct sockaddr *) &sa, &sa_len);
+
+    if (result < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR
+         && errno != ECONNREFUSED)
+        {
+            I_Error("NET_SDL_RecvPacket: Error receiving packet: %s",
+                    strerror(errno));
+        }
+
+        return false;
+    }
+
+    // Put the data into a new packet structure
+
+    *packet = NET_NewPacket(result);
+    memcpy((*packet)->data, buf, result);
+    (*packet)->len = result;
+
+    // Address
+
+    *addr = NET_SDL_FindAddress(&sa);
+
+    return true;
+}
+
+void NET_SDL_AddrToString(net_addr_t *addr, char *buffer, int buffer_len)
+{
+    struct sockaddr_in *sa;
+
+    sa = (struct sockaddr_in *) addr->handle;
+
+    M_snprintf(buffer, buffer_len, "%s:%i",
+               inet_ntoa(sa->sin_addr), ntohs(sa->sin_port));
+}
+
+net_addr_t *NET_SDL_ResolveAddress(char *address)
+{
+    struct sockaddr_in sa;
+    struct hostent *host;
+    char *colon;
+    char *addr_hostname;
+    int addr_port;
+
+    colon = strchr(address, ':');
+
+    addr_hostname = M_StringDuplicate(address);
+
+    if (colon != NULL)
+    {
+        addr_hostname[colon - address] = '\0';
+        addr_port = atoi(colon + 1);
+    }
+    else
+    {
+        addr_port = port;
+    }
+
+    host = gethostbyname(addr_hostname);
+    free(addr_hostname);
+
+    if (host == NULL || host->h_addrtype != AF_INET)
+    {
+        // unable to resolve
+
+        return NULL;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(addr_port);
+    memcpy(&sa.sin_addr, host->h_addr_list[0], sizeof(sa.sin_addr));
+
+    return NET_SDL_FindAddress(&sa);
+}
+
+// Complete module
+
+net_module_t net_sdl_module =
+{
+    NET_SDL_InitClient,
+    NET_SDL_InitServer,
+    NET_SDL_SendPacket,
+    NET_SDL_RecvPacket,
+    NET_SDL_AddrToString,
+    NET_SDL_FreeAddress,
+    NET_SDL_ResolveAddress,
+};
@@ -0,0 +1,1060 @@
+//
+// Copyright(C) 2024 Nikolai Wuttke-Hohendorf
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Network server code.
+//
+//     Clients send their ticcmds to the server, which assembles a
+//     full tic once every player's command for it has arrived and
+//     sends it back to everyone.  There is no separate reliable
+//     channel: each game data packet repeats every tic the other end
+//     has not acknowledged yet, so a lost packet costs no round trip.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "doomtype.h"
+#include "d_mode.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_query.h"
+#include "net_server.h"
+#include "net_structrw.h"
+
+// How often to send waiting data / launch messages while not in game
+
+#define WAITING_INTERVAL  250
+
+// Resend unacknowledged tics after this many ms without new ones
+
+#define RESEND_INTERVAL   50
+
+// Drop a client that has been silent for this long
+
+#define CLIENT_TIMEOUT    10000
+
+typedef enum
+{
+    // waiting for enough players to join
+
+    SERVER_WAITING_LAUNCH,
+
+    // launched; waiting for the controller to send game settings
+
+    SERVER_WAITING_START,
+
+    // in a game
+
+    SERVER_IN_GAME,
+} net_server_state_t;
+
+typedef struct
+{
+    boolean active;
+    net_addr_t *addr;
+    char name[MAXPLAYERNAME];
+    net_connect_data_t connect_data;
+
+    // Player number in game, or -1 for drones.
+
+    int player_number;
+
+    int last_recv_time;
+    int last_send_time;
+
+    // Number of ticcmds received from this client so far
+
+    int recvtic;
+
+    // Number of full tics this client has acknowledged
+
+    int acktic;
+
+    // Full tic count at the time of the last game data packet
+
+    int senttic;
+
+    // Packet sequence numbers, loss and timestamps for RTT measurement
+
+    unsigned int seq;
+    int recv_seq;
+    int packets_received;
+    int packets_lost;
+    int peer_time;
+    int peer_time_recv;
+    int rtt;
+    int max_rtt;
+} net_client_t;
+
+static net_server_state_t server_state;
+static boolean server_initialized = false;
+static net_context_t *server_context;
+
+static net_client_t clients[MAXNETNODES];
+
+// Ticcmds received from each player, indexed by tic
+
+static ticcmd_t sv_ticcmds[BACKUPTICS][NET_MAXPLAYERS];
+
+// Players in game for each full tic
+
+static boolean sv_ingame[BACKUPTICS][NET_MAXPLAYERS];
+
+// Client that controls each player slot, or NULL once the player left
+
+static net_client_t *sv_players[NET_MAXPLAYERS];
+
+// Number of complete tics assembled so far
+
+static int fulltic;
+
+static net_gamesettings_t sv_settings;
+
+// Number of players required before the game is launched
+
+static int sv_nodes = 2;
+
+static int sv_last_waiting_time;
+
+static void NET_SV_DisconnectClient(net_client_t *client);
+
+static int NumPlayers(void)
+{
+    int result = 0;
+    int i;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active && !clients[i].connect_data.drone)
+        {
+            ++result;
+        }
+    }
+
+    return result;
+}
+
+static int NumDrones(void)
+{
+    int result = 0;
+    int i;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active && clients[i].connect_data.drone)
+        {
+            ++result;
+        }
+    }
+
+    return result;
+}
+
+// The controller is the first client to connect; it sends the game
+// settings when the game starts.
+
+static net_client_t *NET_SV_Controller(void)
+{
+    int i;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active && !clients[i].connect_data.drone)
+        {
+            return &clients[i];
+        }
+    }
+
+    return NULL;
+}
+
+static net_client_t *NET_SV_FindClient(net_addr_t *addr)
+{
+    int i;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active && clients[i].addr == addr)
+        {
+            return &clients[i];
+        }
+    }
+
+    return NULL;
+}
+
+static net_packet_t *NET_SV_NewPacket(net_packet_type_t type)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, type);
+
+    return packet;
+}
+
+static void NET_SV_SendTo(net_addr_t *addr, net_packet_t *packet)
+{
+    NET_SendPacket(addr, packet);
+    NET_FreePacket(packet);
+}
+
+// Timestamps carried by waiting data and game data packets.  The
+// receiver echoes our send time back together with how long it held
+// it, which gives the round trip time without synchronized clocks.
+
+static void NET_SV_WriteTimes(net_packet_t *packet, net_client_t *client)
+{
+    int nowtime = I_GetTimeMS();
+
+    NET_WriteInt32(packet, nowtime);
+    NET_WriteInt32(packet, client->peer_time);
+    NET_WriteInt32(packet, client->peer_time_recv < 0 ? -1 :
+                           nowtime - client->peer_time_recv);
+}
+
+static boolean NET_SV_ReadTimes(net_packet_t *packet, net_client_t *client)
+{
+    unsigned int sendtime, echotime;
+    signed int holdtime;
+    int nowtime, rtt;
+
+    if (!NET_ReadInt32(packet, &sendtime)
+     || !NET_ReadInt32(packet, &echotime)
+     || !NET_ReadSInt32(packet, &holdtime))
+    {
+        return false;
+    }
+
+    nowtime = I_GetTimeMS();
+
+    client->peer_time = sendtime;
+    client->peer_time_recv = nowtime;
+
+    if (holdtime >= 0)
+    {
+        rtt = nowtime - (int) echotime - holdtime;
+
+        if (rtt >= 0)
+        {
+            client->rtt = client->rtt < 0 ? rtt
+                                          : (client->rtt * 7 + rtt) / 8;
+
+            if (rtt > client->max_rtt)
+            {
+                client->max_rtt = rtt;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void NET_SV_SendReject(net_addr_t *addr, char *msg)
+{
+    net_packet_t *packet;
+
+    packet = NET_SV_NewPacket(NET_PACKET_TYPE_REJECTED);
+    NET_WriteString(packet, msg);
+    NET_SV_SendTo(addr, packet);
+}
+
+static void NET_SV_SendWaitingData(net_client_t *client)
+{
+    net_waitdata_t wait_data;
+    net_client_t *controller;
+    net_packet_t *packet;
+    int i;
+
+    memset(&wait_data, 0, sizeof(wait_data));
+
+    controller = NET_SV_Controller();
+
+    wait_data.num_players = 0;
+    wait_data.num_drones = NumDrones();
+    wait_data.max_players = NET_MAXPLAYERS;
+    wait_data.is_controller = client == controller;
+    wait_data.consoleplayer = -1;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (!clients[i].active || clients[i].connect_data.drone)
+        {
+            continue;
+        }
+
+        if (&clients[i] == client)
+        {
+            wait_data.consoleplayer = wait_data.num_players;
+        }
+
+        M_StringCopy(wait_data.player_names[wait_data.num_players],
+                     clients[i].name, MAXPLAYERNAME);
+        M_StringCopy(wait_data.player_addrs[wait_data.num_players],
+                     NET_AddrToString(clients[i].addr), MAXPLAYERNAME);
+        ++wait_data.num_players;
+    }
+
+    wait_data.ready_players = wait_data.num_players;
+
+    if (controller != NULL)
+    {
+        memcpy(wait_data.wad_sha1sum, controller->connect_data.wad_sha1sum,
+               sizeof(sha1_digest_t));
+        memcpy(wait_data.deh_sha1sum, controller->connect_data.deh_sha1sum,
+               sizeof(sha1_digest_t));
+        wait_data.is_freedoom = controller->connect_data.is_freedoom;
+    }
+
+    packet = NET_SV_NewPacket(NET_PACKET_TYPE_WAITING_DATA);
+    NET_WriteWaitData(packet, &wait_data);
+    NET_SV_WriteTimes(packet, client);
+    NET_SV_SendTo(client->addr, packet);
+}
+
+static void NET_SV_ParseSYN(net_packet_t *packet, net_addr_t *addr)
+{
+    net_connect_data_t data;
+    net_client_t *client;
+    net_client_t *controller;
+    unsigned int magic;
+    char *player_name;
+    net_packet_t *reply;
+    int i;
+
+    if (!NET_ReadInt32(packet, &magic) || magic != NET_MAGIC_NUMBER
+     || !NET_ReadConnectData(packet, &data))
+    {
+        return;
+    }
+
+    player_name = NET_SafeReadString(packet);
+
+    if (player_name == NULL)
+    {
+        return;
+    }
+
+    client = NET_SV_FindClient(addr);
+
+    if (client == NULL)
+    {
+        if (server_state != SERVER_WAITING_LAUNCH)
+        {
+            NET_SV_SendReject(addr, "Server is not accepting connections");
+            return;
+        }
+
+        if (!data.drone && NumPlayers() >= NET_MAXPLAYERS)
+        {
+            NET_SV_SendReject(addr, "Server is full!");
+            return;
+        }
+
+        // The first client decides which game we are playing.
+
+        controller = NET_SV_Controller();
+
+        if (controller != NULL
+         && (data.gamemode != controller->connect_data.gamemode
+          || data.gamemission != controller->connect_data.gamemission))
+        {
+            NET_SV_SendReject(addr, "You are playing the wrong game!");
+            return;
+        }
+
+        if (controller != NULL
+         && memcmp(data.wad_sha1sum, controller->connect_data.wad_sha1sum,
+                   sizeof(sha1_digest_t)) != 0)
+        {
+            printf("NET_SV: Warning: %s is using a different WAD "
+                   "directory.\n", NET_AddrToString(addr));
+        }
+
+        for (i = 0; i < MAXNETNODES; ++i)
+        {
+            if (!clients[i].active)
+            {
+                break;
+            }
+        }
+
+        if (i == MAXNETNODES)
+        {
+            NET_SV_SendReject(addr, "Server is full!");
+            return;
+        }
+
+        client = &clients[i];
+        memset(client, 0, sizeof(*client));
+        client->active = true;
+        client->addr = addr;
+        client->connect_data = data;
+        client->player_number = -1;
+        client->recv_seq = -1;
+        client->peer_time_recv = -1;
+        client->rtt = -1;
+        M_StringCopy(client->name, player_name, sizeof(client->name));
+
+        printf("NET_SV: %s connected from %s\n",
+               client->name, NET_AddrToString(addr));
+    }
+
+    client->last_recv_time = I_GetTimeMS();
+
+    // Acknowledge; a repeated SYN means the first ACK was lost.
+
+    reply = NET_SV_NewPacket(NET_PACKET_TYPE_ACK);
+    NET_SV_SendTo(addr, reply);
+}
+
+// Picks a ticdup value based on the smoothed round trip times measured
+// while waiting for the game to start.  Slow links run at a lower tic rate
+// so that fewer, larger packets are in flight.
+
+static int NET_SV_AdaptiveTicdup(void)
+{
+    int worst_rtt = 0;
+    int result;
+    int i;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active && clients[i].rtt > worst_rtt)
+        {
+            worst_rtt = clients[i].rtt;
+        }
+    }
+
+    if (worst_rtt < 100)
+    {
+        result = 1;
+    }
+    else if (worst_rtt < 200)
+    {
+        result = 2;
+    }
+    else
+    {
+        result = 3;
+    }
+
+    printf("NET_SV: Worst round trip time %ims, using ticdup %i\n",
+           worst_rtt, result);
+
+    return result;
+}
+
+static void NET_SV_SendGameStart(net_client_t *client)
+{
+    net_gamesettings_t settings;
+    net_packet_t *packet;
+
+    settings = sv_settings;
+    settings.consoleplayer = client->player_number < 0 ? 0
+                                                       : client->player_number;
+
+    packet = NET_SV_NewPacket(NET_PACKET_TYPE_GAMESTART);
+    NET_WriteSettings(packet, &settings);
+    NET_SV_SendTo(client->addr, packet);
+}
+
+static void NET_SV_StartGame(net_gamesettings_t *settings)
+{
+    int num_players;
+    int i;
+
+    sv_settings = *settings;
+
+    // Assign player numbers in connection order.
+
+    memset(sv_players, 0, sizeof(sv_players));
+    num_players = 0;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (!clients[i].active)
+        {
+            continue;
+        }
+
+        if (clients[i].connect_data.drone)
+        {
+            clients[i].player_number = -1;
+        }
+        else
+        {
+            sv_settings.player_classes[num_players] =
+                clients[i].connect_data.player_class;
+            clients[i].player_number = num_players;
+            sv_players[num_players] = &clients[i];
+            ++num_players;
+        }
+
+        clients[i].recvtic = 0;
+        clients[i].acktic = 0;
+        clients[i].senttic = 0;
+    }
+
+    sv_settings.num_players = num_players;
+
+    if (sv_settings.ticdup == 0)
+    {
+        sv_settings.ticdup = NET_SV_AdaptiveTicdup();
+    }
+
+    fulltic = 0;
+    server_state = SERVER_IN_GAME;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active)
+        {
+            NET_SV_SendGameStart(&clients[i]);
+        }
+    }
+}
+
+// The controller can launch the game before -nodes players joined.
+
+static void NET_SV_ParseLaunch(net_packet_t *packet, net_client_t *client)
+{
+    if (server_state == SERVER_WAITING_LAUNCH
+     && client == NET_SV_Controller())
+    {
+        server_state = SERVER_WAITING_START;
+        sv_last_waiting_time = 0;
+    }
+}
+
+static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
+{
+    net_gamesettings_t settings;
+
+    if (server_state == SERVER_IN_GAME)
+    {
+        // The client missed its game start message; send it again.
+
+        NET_SV_SendGameStart(client);
+        return;
+    }
+
+    if (server_state != SERVER_WAITING_START
+     || client != NET_SV_Controller()
+     || !NET_ReadSettings(packet, &settings))
+    {
+        return;
+    }
+
+    NET_SV_StartGame(&settings);
+}
+
+static void NET_SV_ParseKeepalive(net_packet_t *packet, net_client_t *client)
+{
+    NET_SV_ReadTimes(packet, client);
+
+    // Clients only send keepalives before the game starts, so this
+    // one missed its launch and game start messages.
+
+    if (server_state == SERVER_IN_GAME)
+    {
+        NET_SV_SendGameStart(client);
+    }
+}
+
+static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
+{
+    net_ticdiff_t diff;
+    ticcmd_t cmd;
+    unsigned int seq, acktic, starttic, count;
+    unsigned int i;
+    int tic, gap;
+
+    if (server_state != SERVER_IN_GAME
+     || !NET_ReadInt16(packet, &seq)
+     || !NET_SV_ReadTimes(packet, client)
+     || !NET_ReadInt32(packet, &acktic)
+     || !NET_ReadInt32(packet, &starttic)
+     || !NET_ReadInt8(packet, &count))
+    {
+        return;
+    }
+
+    ++client->packets_received;
+
+    if (client->recv_seq >= 0)
+    {
+        gap = (seq - client->recv_seq) & 0xffff;
+
+        if (gap != 0 && gap < 0x8000)
+        {
+            client->packets_lost += gap - 1;
+            client->recv_seq = seq;
+        }
+    }
+    else
+    {
+        client->recv_seq = seq;
+    }
+
+    if ((int) acktic > client->acktic && (int) acktic <= fulltic)
+    {
+        client->acktic = acktic;
+    }
+
+    if (client->player_number < 0)
+    {
+        return;
+    }
+
+    // Each tic is a diff against the previous one in the packet.
+
+    memset(&cmd, 0, sizeof(cmd));
+
+    for (i = 0; i < count; ++i)
+    {
+        if (!NET_ReadTiccmdDiff(packet, &diff, sv_settings.lowres_turn))
+        {
+            return;
+        }
+
+        NET_TiccmdPatch(&cmd, &diff, &cmd);
+
+        tic = starttic + i;
+
+        if (tic == client->recvtic && tic - fulltic < BACKUPTICS)
+        {
+            sv_ticcmds[tic % BACKUPTICS][client->player_number] = cmd;
+            ++client->recvtic;
+        }
+    }
+}
+
+static void NET_SV_ParseDisconnect(net_packet_t *packet, net_client_t *client)
+{
+    net_packet_t *reply;
+
+    reply = NET_SV_NewPacket(NET_PACKET_TYPE_DISCONNECT_ACK);
+    NET_SendPacket(client->addr, reply);
+    NET_FreePacket(reply);
+
+    printf("NET_SV: %s left the game\n", client->name);
+
+    NET_SV_DisconnectClient(client);
+}
+
+static void NET_SV_SendQueryResponse(net_addr_t *addr)
+{
+    net_querydata_t querydata;
+    net_client_t *controller;
+    net_packet_t *reply;
+
+    controller = NET_SV_Controller();
+
+    querydata.version = PACKAGE_STRING;
+    querydata.server_state = server_state != SERVER_WAITING_LAUNCH;
+    querydata.num_players = NumPlayers();
+    querydata.max_players = NET_MAXPLAYERS;
+    querydata.gamemode = controller != NULL ?
+                         controller->connect_data.gamemode : indetermined;
+    querydata.gamemission = controller != NULL ?
+                            controller->connect_data.gamemission : none;
+    querydata.description = "Doom server";
+
+    reply = NET_SV_NewPacket(NET_PACKET_TYPE_QUERY_RESPONSE);
+    NET_WriteQueryData(reply, &querydata);
+    NET_SV_SendTo(addr, reply);
+}
+
+static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
+{
+    net_client_t *client;
+    unsigned int packet_type;
+
+    if (!NET_ReadInt16(packet, &packet_type))
+    {
+        return;
+    }
+
+    if (packet_type == NET_PACKET_TYPE_SYN)
+    {
+        NET_SV_ParseSYN(packet, addr);
+        return;
+    }
+    else if (packet_type == NET_PACKET_TYPE_QUERY)
+    {
+        NET_SV_SendQueryResponse(addr);
+        return;
+    }
+
+    client = NET_SV_FindClient(addr);
+
+    if (client == NULL)
+    {
+        return;
+    }
+
+    client->last_recv_time = I_GetTimeMS();
+
+    switch (packet_type)
+    {
+        case NET_PACKET_TYPE_KEEPALIVE:
+            NET_SV_ParseKeepalive(packet, client);
+            break;
+        case NET_PACKET_TYPE_LAUNCH:
+            NET_SV_ParseLaunch(packet, client);
+            break;
+        case NET_PACKET_TYPE_GAMESTART:
+            NET_SV_ParseGameStart(packet, client);
+            break;
+        case NET_PACKET_TYPE_GAMEDATA:
+            NET_SV_ParseGameData(packet, client);
+            break;
+        case NET_PACKET_TYPE_DISCONNECT:
+            NET_SV_ParseDisconnect(packet, client);
+            break;
+        default:
+            break;
+    }
+}
+
+static void NET_SV_PrintClientStats(net_client_t *client)
+{
+    if (client->packets_received == 0)
+    {
+        return;
+    }
+
+    printf("NET_SV: %s: %i packets received, %i lost, "
+           "rtt %ims (max %ims)\n",
+           client->name, client->packets_received, client->packets_lost,
+           client->rtt, client->max_rtt);
+}
+
+static void NET_SV_DisconnectClient(net_client_t *client)
+{
+    int i;
+
+    NET_SV_PrintClientStats(client);
+
+    client->active = false;
+
+    // A player leaving stops counting towards full tics; they are
+    // marked as out of the game from the next assembled tic onwards.
+
+    for (i = 0; i < NET_MAXPLAYERS; ++i)
+    {
+        if (sv_players[i] == client)
+        {
+            sv_players[i] = NULL;
+        }
+    }
+
+    NET_FreeAddress(client->addr);
+}
+
+// Assemble full tics for which every player's command has arrived.
+
+static void NET_SV_AssembleTics(void)
+{
+    boolean any_players;
+    int lowtic;
+    int i;
+
+    lowtic = fulltic + BACKUPTICS;
+    any_players = false;
+
+    for (i = 0; i < sv_settings.num_players; ++i)
+    {
+        if (sv_players[i] != NULL)
+        {
+            any_players = true;
+
+            if (sv_players[i]->recvtic < lowtic)
+            {
+                lowtic = sv_players[i]->recvtic;
+            }
+        }
+    }
+
+    if (!any_players)
+    {
+        return;
+    }
+
+    for (; fulltic < lowtic; ++fulltic)
+    {
+        for (i = 0; i < NET_MAXPLAYERS; ++i)
+        {
+            sv_ingame[fulltic % BACKUPTICS][i] = sv_players[i] != NULL;
+        }
+    }
+}
+
+// Send all full tics the client has not acknowledged yet.
+
+static void NET_SV_SendTics(net_client_t *client)
+{
+    ticcmd_t prev[NET_MAXPLAYERS];
+    net_ticdiff_t diff;
+    net_packet_t *packet;
+    unsigned int ingame_bits;
+    int starttic, count;
+    int tic, i;
+
+    starttic = client->acktic;
+    count = fulltic - starttic;
+
+    if (count > NET_MAXTICSPERPACKET)
+    {
+        count = NET_MAXTICSPERPACKET;
+    }
+
+    packet = NET_SV_NewPacket(NET_PACKET_TYPE_GAMEDATA);
+    NET_WriteInt16(packet, client->seq++ & 0xffff);
+    NET_SV_WriteTimes(packet, client);
+
+    // Acknowledge the ticcmds received from this client.
+
+    NET_WriteInt32(packet, client->recvtic);
+    NET_WriteInt32(packet, starttic);
+    NET_WriteInt8(packet, count);
+
+    memset(prev, 0, sizeof(prev));
+
+    for (tic = starttic; tic < starttic + count; ++tic)
+    {
+        ingame_bits = 0;
+
+        for (i = 0; i < NET_MAXPLAYERS; ++i)
+        {
+            if (sv_ingame[tic % BACKUPTICS][i])
+            {
+                ingame_bits |= 1 << i;
+            }
+        }
+
+        NET_WriteInt8(packet, ingame_bits);
+
+        // The client already knows its own commands.
+
+        for (i = 0; i < NET_MAXPLAYERS; ++i)
+        {
+            if ((ingame_bits & (1 << i)) != 0 && i != client->player_number)
+            {
+                NET_TiccmdDiff(&prev[i], &sv_ticcmds[tic % BACKUPTICS][i],
+                               &diff);
+                NET_WriteTiccmdDiff(packet, &diff, sv_settings.lowres_turn);
+                prev[i] = sv_ticcmds[tic % BACKUPTICS][i];
+            }
+        }
+    }
+
+    NET_SV_SendTo(client->addr, packet);
+
+    client->senttic = fulltic;
+    client->last_send_time = I_GetTimeMS();
+}
+
+static void NET_SV_RunClient(net_client_t *client)
+{
+    int nowtime = I_GetTimeMS();
+
+    if (nowtime - client->last_recv_time > CLIENT_TIMEOUT)
+    {
+        printf("NET_SV: %s timed out\n", client->name);
+        NET_SV_DisconnectClient(client);
+        return;
+    }
+
+    if (server_state != SERVER_IN_GAME)
+    {
+        return;
+    }
+
+    // Tics this old can no longer be resent.
+
+    if (fulltic - client->acktic >= BACKUPTICS)
+    {
+        printf("NET_SV: %s fell too far behind\n", client->name);
+        NET_SV_DisconnectClient(client);
+        return;
+    }
+
+    if (fulltic > client->senttic
+     || (client->acktic < fulltic
+      && nowtime - client->last_send_time >= RESEND_INTERVAL)
+     || nowtime - client->last_send_time >= 1000)
+    {
+        NET_SV_SendTics(client);
+    }
+}
+
+static void NET_SV_RunWaiting(void)
+{
+    net_packet_t *packet;
+    int nowtime;
+    int i;
+
+    nowtime = I_GetTimeMS();
+
+    if (server_state == SERVER_WAITING_LAUNCH && NumPlayers() >= sv_nodes)
+    {
+        printf("NET_SV: %i players connected, launching game\n",
+               NumPlayers());
+        server_state = SERVER_WAITING_START;
+        sv_last_waiting_time = 0;
+    }
+
+    if (sv_last_waiting_time != 0
+     && nowtime - sv_last_waiting_time < WAITING_INTERVAL)
+    {
+        return;
+    }
+
+    sv_last_waiting_time = nowtime;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (!clients[i].active)
+        {
+            continue;
+        }
+
+        if (server_state == SERVER_WAITING_START)
+        {
+            packet = NET_SV_NewPacket(NET_PACKET_TYPE_LAUNCH);
+            NET_SV_SendTo(clients[i].addr, packet);
+        }
+
+        // Waiting data doubles as the RTT probe for adaptive ticdup.
+
+        NET_SV_SendWaitingData(&clients[i]);
+    }
+}
+
+void NET_SV_Init(void)
+{
+    int p;
+
+    //!
+    // @category net
+    // @arg <n>
+    //
+    // Launch the game once this many players have joined the
+    // server (default 2).
+    //
+
+    p = M_CheckParmWithArgs("-nodes", 1);
+
+    if (p > 0)
+    {
+        sv_nodes = atoi(myargv[p+1]);
+
+        if (sv_nodes < 1 || sv_nodes > NET_MAXPLAYERS)
+        {
+            I_Error("NET_SV_Init: Invalid number of nodes: %i", sv_nodes);
+        }
+    }
+
+    server_context = NET_NewContext();
+    memset(clients, 0, sizeof(clients));
+    memset(sv_players, 0, sizeof(sv_players));
+    server_state = SERVER_WAITING_LAUNCH;
+    sv_last_waiting_time = 0;
+    fulltic = 0;
+
+    server_initialized = true;
+}
+
+void NET_SV_AddModule(net_module_t *module)
+{
+    module->InitServer();
+    NET_AddModule(server_context, module);
+}
+
+void NET_SV_Run(void)
+{
+    net_addr_t *addr;
+    net_packet_t *packet;
+    int i;
+
+    if (!server_initialized)
+    {
+        return;
+    }
+
+    while (NET_RecvPacket(server_context, &addr, &packet))
+    {
+        NET_SV_Packet(packet, addr);
+        NET_FreePacket(packet);
+    }
+
+    if (server_state == SERVER_IN_GAME)
+    {
+        NET_SV_AssembleTics();
+    }
+    else
+    {
+        NET_SV_RunWaiting();
+    }
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active)
+        {
+            NET_SV_RunClient(&clients[i]);
+        }
+    }
+}
+
+void NET_SV_Shutdown(void)
+{
+    net_packet_t *packet;
+    int i;
+
+    if (!server_initialized)
+    {
+        return;
+    }
+
+    printf("NET_SV: Shutting down server...\n");
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active)
+        {
+            packet = NET_SV_NewPacket(NET_PACKET_TYPE_DISCONNECT);
+            NET_SV_SendTo(clients[i].addr, packet);
+            NET_SV_PrintClientStats(&clients[i]);
+            clients[i].active = false;
+        }
+    }
+
+    server_initialized = false;
+}
+
+// There is no master server support; the server can be found on the
+// local network or by address.
+
+void NET_SV_RegisterWithMaster(void)
+{
+}
@@ -20,9 +20,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "m_random.h"
 #include "i_system.h"
+#include "z_zone.h"
 
 #include "doomdef.h"
 #include "p_local.h"
@@ -88,57 +90,229 @@ void A_Fall (mobj_t *actor);
 
 
 //
-// Called by P_NoiseAlert.
-// Recursively traverse adjacent sectors,
-// sound blocking lines cut off traversal.
+// SOUND PROPAGATION
+// Sectors are connected through their two sided lines, and sound
+// spreads from sector to sector through the open ones. Sound blocking
+// lines cut off traversal after the first one.
+//
+// Whether a line is open only depends on the heights of the sectors
+// on both sides, so the lines of a sector are only looked at again
+// after T_MovePlane has moved it.
 //
 
+typedef struct
+{
+    int		other;		// sector on the other side
+    int		line;
+    boolean	soundblock;
+
+} soundedge_t;
+
+typedef struct
+{
+    soundedge_t*	edges;
+    int			numedges;
+
+    // on the soundmoved list
+    boolean		moved;
+
+    // if == validcount, already on the soundseeds list
+    int			seedcount;
+
+} soundnode_t;
+
 mobj_t*		soundtarget;
 
-void
-P_RecursiveSound
-( sector_t*	sec,
-  int		soundblocks )
+static soundnode_t*	soundnodes;
+
+// Line is open, indexed by line number
+static byte*		soundlineopen;
+
+// Sectors moved since the last alert
+static int*		soundmoved;
+static int		numsoundmoved;
+
+// Sectors to flood from, and sectors only reachable through a sound
+// blocking line.
+static int*		soundqueue;
+static int*		soundseeds;
+
+
+static void P_UpdateSoundLines (soundnode_t* node)
 {
     int		i;
-    line_t*	check;
-    sector_t*	other;
-	
-    // wake up all monsters in this sector
-    if (sec->validcount == validcount
-	&& sec->soundtraversed <= soundblocks+1)
+    sector_t*	front;
+    sector_t*	back;
+    fixed_t	top;
+    fixed_t	bottom;
+
+    for (i=0 ; i<node->numedges ; i++)
     {
-	return;		// already flooded
+	front = lines[node->edges[i].line].frontsector;
+	back = lines[node->edges[i].line].backsector;
+
+	// same as openrange from P_LineOpening
+	if (front->ceilingheight < back->ceilingheight)
+	    top = front->ceilingheight;
+	else
+	    top = back->ceilingheight;
+
+	if (front->floorheight > back->floorheight)
+	    bottom = front->floorheight;
+	else
+	    bottom = back->floorheight;
+
+	soundlineopen[node->edges[i].line] = top - bottom > 0;
     }
-    
-    sec->validcount = validcount;
-    sec->soundtraversed = soundblocks+1;
-    sec->soundtarget = soundtarget;
-	
-    for (i=0 ;i<sec->linecount ; i++)
+}
+
+
+//
+// P_BuildSoundGraph
+// Called by P_SetupLevel, after P_GroupLines.
+//
+void P_BuildSoundGraph (void)
+{
+    int			i;
+    int			j;
+    int			numedges;
+    sector_t*		sec;
+    line_t*		check;
+    sector_t*		other;
+    soundedge_t*	edges;
+
+    // count the lines sound can pass through
+    numedges = 0;
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
     {
-	check = sec->lines[i];
-	if (! (check->flags & ML_TWOSIDED) )
-	    continue;
-	
-	P_LineOpening (check);
+	for (j=0 ; j<sec->linecount ; j++)
+	{
+	    check = sec->lines[j];
 
-	if (openrange <= 0)
-	    continue;	// closed door
-	
-	if ( sides[ check->sidenum[0] ].sector == sec)
-	    other = sides[ check->sidenum[1] ] .sector;
-	else
-	    other = sides[ check->sidenum[0] ].sector;
-	
-	if (check->flags & ML_SOUNDBLOCK)
+	    if ((check->flags & ML_TWOSIDED) && check->sidenum[1] != -1
+	     && check->frontsector != check->backsector)
+	    {
+		numedges++;
+	    }
+	}
+    }
+
+    soundnodes = Z_Malloc (numsectors*sizeof(soundnode_t), PU_LEVEL, 0);
+    edges = Z_Malloc (numedges*sizeof(soundedge_t), PU_LEVEL, 0);
+    soundlineopen = Z_Malloc (numlines, PU_LEVEL, 0);
+    soundmoved = Z_Malloc (numsectors*sizeof(int), PU_LEVEL, 0);
+    soundqueue = Z_Malloc (numsectors*sizeof(int), PU_LEVEL, 0);
+    soundseeds = Z_Malloc (numsectors*sizeof(int), PU_LEVEL, 0);
+    numsoundmoved = 0;
+
+    memset (soundlineopen, 0, numlines);
+
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+    {
+	soundnodes[i].edges = edges;
+	soundnodes[i].numedges = 0;
+	soundnodes[i].moved = false;
+	soundnodes[i].seedcount = 0;
+
+	for (j=0 ; j<sec->linecount ; j++)
+	{
+	    check = sec->lines[j];
+
+	    if (!(check->flags & ML_TWOSIDED) || check->sidenum[1] == -1
+	     || check->frontsector == check->backsector)
+	    {
+		continue;
+	    }
+
+	    if ( sides[ check->sidenum[0] ].sector == sec)
+		other = sides[ check->sidenum[1] ] .sector;
+	    else
+		other = sides[ check->sidenum[0] ].sector;
+
+	    edges->other = other - sectors;
+	    edges->line = check - lines;
+	    edges->soundblock = (check->flags & ML_SOUNDBLOCK) != 0;
+	    edges++;
+	    soundnodes[i].numedges++;
+	}
+
+	P_UpdateSoundLines (&soundnodes[i]);
+    }
+}
+
+
+//
+// P_SoundSectorMoved
+// Called when the floor or ceiling of a sector might have moved.
+//
+void P_SoundSectorMoved (sector_t* sec)
+{
+    soundnode_t*	node;
+
+    node = &soundnodes[sec - sectors];
+
+    if (!node->moved)
+    {
+	node->moved = true;
+	soundmoved[numsoundmoved++] = sec - sectors;
+    }
+}
+
+
+//
+// Called by P_NoiseAlert.
+// Floods the sectors reachable from the queued ones,
+// and returns the number of sectors that can only be
+// reached through a sound blocking line.
+//
+static int
+P_SpreadSound
+( int		count,
+  int		soundblocks )
+{
+    int			head;
+    int			i;
+    int			numseeds;
+    soundnode_t*	node;
+    soundedge_t*	edge;
+    sector_t*		other;
+
+    numseeds = 0;
+
+    for (head=0 ; head<count ; head++)
+    {
+	node = &soundnodes[soundqueue[head]];
+
+	for (i=0, edge=node->edges ; i<node->numedges ; i++, edge++)
 	{
-	    if (!soundblocks)
-		P_RecursiveSound (other, 1);
+	    if (!soundlineopen[edge->line])
+		continue;	// closed door
+
+	    other = &sectors[edge->other];
+
+	    if (other->validcount == validcount)
+		continue;	// already flooded
+
+	    if (edge->soundblock)
+	    {
+		if (!soundblocks
+		 && soundnodes[edge->other].seedcount != validcount)
+		{
+		    soundnodes[edge->other].seedcount = validcount;
+		    soundseeds[numseeds++] = edge->other;
+		}
+		continue;
+	    }
+
+	    // wake up all monsters in this sector
+	    other->validcount = validcount;
+	    other->soundtraversed = soundblocks+1;
+	    other->soundtarget = soundtarget;
+	    soundqueue[count++] = edge->other;
 	}
-	else
-	    P_RecursiveSound (other, soundblocks);
     }
+
+    return numseeds;
 }
 
 
@@ -148,14 +322,53 @@ P_RecursiveSound
 // If a monster yells at a player,
 // it will alert other monsters to the player.
 //
+// Sectors behind one sound blocking line are only flooded once all
+// others are, so that each sector is visited once; the result is the
+// same as the recursive flood in vanilla.
+//
 void
 P_NoiseAlert
 ( mobj_t*	target,
   mobj_t*	emmiter )
 {
+    int		i;
+    int		count;
+    int		numseeds;
+    sector_t*	sec;
+
     soundtarget = target;
     validcount++;
-    P_RecursiveSound (emmiter->subsector->sector, 0);
+
+    for (i=0 ; i<numsoundmoved ; i++)
+    {
+	soundnodes[soundmoved[i]].moved = false;
+	P_UpdateSoundLines (&soundnodes[soundmoved[i]]);
+    }
+    numsoundmoved = 0;
+
+    sec = emmiter->subsector->sector;
+    sec->validcount = validcount;
+    sec->soundtraversed = 1;
+    sec->soundtarget = soundtarget;
+    soundqueue[0] = sec - sectors;
+
+    numseeds = P_SpreadSound (1, 0);
+
+    count = 0;
+    for (i=0 ; i<numseeds ; i++)
+    {
+	sec = &sectors[soundseeds[i]];
+
+	if (sec->validcount == validcount)
+	    continue;
+
+	sec->validcount = validcount;
+	sec->soundtraversed = 2;
+	sec->soundtarget = soundtarget;
+	soundqueue[count++] = soundseeds[i];
+    }
+
+    P_SpreadSound (count, 1);
 }
 
 
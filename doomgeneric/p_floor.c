@@ -35,6 +35,8 @@
 // FLOORS
 //
 
+int	planechanges;
+
 //
 // Move a plane (floor or ceiling) and check for crushing
 //
@@ -49,6 +51,9 @@ T_MovePlane
 {
     boolean	flag;
     fixed_t	lastpos;
+
+    planechanges++;
+    P_SoundSectorMoved (sector);
 	
     switch(floorOrCeiling)
     {
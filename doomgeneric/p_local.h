@@ -71,6 +71,11 @@ void P_InitThinkers (void);
 void P_AddThinker (thinker_t* thinker);
 void P_RemoveThinker (thinker_t* thinker);
 
+// set by -profilethinkers
+extern	boolean		thinkerprofiling;
+
+void P_ProfileAction (mobj_t* mobj, state_t* st);
+
 
 //
 // P_PSPR
@@ -125,6 +130,8 @@ void	P_SpawnPlayerMissile (mobj_t* source, mobjtype_t type);
 // P_ENEMY
 //
 void P_NoiseAlert (mobj_t* target, mobj_t* emmiter);
+void P_BuildSoundGraph (void);
+void P_SoundSectorMoved (sector_t* sec);
 
 
 //
@@ -149,12 +156,14 @@ typedef struct
     }			d;
 } intercept_t;
 
-// Extended MAXINTERCEPTS, to allow for intercepts overrun emulation.
+// Initial size of the intercepts buffer, which grows as needed.
+// Extended from MAXINTERCEPTS_ORIGINAL, to allow for intercepts overrun
+// emulation.
 
 #define MAXINTERCEPTS_ORIGINAL 128
 #define MAXINTERCEPTS          (MAXINTERCEPTS_ORIGINAL + 61)
 
-extern intercept_t	intercepts[MAXINTERCEPTS];
+extern intercept_t*	intercepts;
 extern intercept_t*	intercept_p;
 
 typedef boolean (*traverser_t) (intercept_t *in);
@@ -227,6 +236,9 @@ boolean P_TryMove (mobj_t* thing, fixed_t x, fixed_t y);
 boolean P_TeleportMove (mobj_t* thing, fixed_t x, fixed_t y);
 void	P_SlideMove (mobj_t* mo);
 boolean P_CheckSight (mobj_t* t1, mobj_t* t2);
+void	P_InitSight (void);
+void	P_PrecomputeSight (void);
+void	P_ClearSightCache (void);
 void 	P_UseLines (player_t* player);
 
 boolean P_ChangeSector (sector_t* sector, boolean crunch);
@@ -267,6 +279,24 @@ extern fixed_t		bmaporgx;
 extern fixed_t		bmaporgy;	// origin of block map
 extern mobj_t**		blocklinks;	// for thing chains
 
+// The things in each blocklinks chain, as an array, for iteration.
+typedef struct
+{
+    mobj_t**	things;		// last entry is the head of the chain
+    int		numthings;
+    int		maxthings;
+    int		changes;	// bumped when a thing is (un)linked
+
+} blockthings_t;
+
+extern blockthings_t*	blockthings;
+
+// The lines of each block's blockmap list, as pointers, for iteration.
+// The lines of block n are blocklinelist[blocklineoffsets[n]] up to
+// (not including) blocklinelist[blocklineoffsets[n+1]].
+extern int*		blocklineoffsets;
+extern line_t**		blocklinelist;
+
 
 
 //
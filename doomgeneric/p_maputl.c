@@ -23,8 +23,11 @@
 
 
 #include <stdlib.h>
+#include <string.h>
 
 
+#include "z_zone.h"
+#include "i_system.h"
 #include "m_bbox.h"
 
 #include "doomdef.h"
@@ -332,6 +335,57 @@ void P_LineOpening (line_t* linedef)
 //
 
 
+//
+// P_AddBlockThing
+// Adds a thing that has just been linked in at the head of a
+// blocklinks chain to the block's array.
+//
+static void P_AddBlockThing (blockthings_t* block, mobj_t* thing)
+{
+    mobj_t**	things;
+
+    if (block->numthings == block->maxthings)
+    {
+	block->maxthings = block->maxthings ? block->maxthings * 2 : 4;
+	things = Z_Malloc(block->maxthings * sizeof(mobj_t *), PU_LEVEL, 0);
+
+	if (block->things)
+	{
+	    memcpy(things, block->things, block->numthings * sizeof(mobj_t *));
+	    Z_Free(block->things);
+	}
+
+	block->things = things;
+    }
+
+    block->things[block->numthings++] = thing;
+    block->changes++;
+}
+
+
+//
+// P_RemoveBlockThing
+// Removes a thing unlinked from a blocklinks chain from the
+// block's array, keeping the order of the others.
+//
+static void P_RemoveBlockThing (blockthings_t* block, mobj_t* thing)
+{
+    int		i;
+
+    for (i=block->numthings-1 ; i>=0 ; i--)
+    {
+	if (block->things[i] == thing)
+	{
+	    memmove(&block->things[i], &block->things[i+1],
+		    (block->numthings - i - 1) * sizeof(mobj_t *));
+	    block->numthings--;
+	    block->changes++;
+	    return;
+	}
+    }
+}
+
+
 //
 // P_UnsetThingPosition
 // Unlinks a thing from block map and sectors.
@@ -361,6 +415,9 @@ void P_UnsetThingPosition (mobj_t* thing)
     {
 	// inert things don't need to be in blockmap
 	// unlink from block map
+	blockx = (thing->x - bmaporgx)>>MAPBLOCKSHIFT;
+	blocky = (thing->y - bmaporgy)>>MAPBLOCKSHIFT;
+
 	if (thing->bnext)
 	    thing->bnext->bprev = thing->bprev;
 	
@@ -368,15 +425,18 @@ void P_UnsetThingPosition (mobj_t* thing)
 	    thing->bprev->bnext = thing->bnext;
 	else
 	{
-	    blockx = (thing->x - bmaporgx)>>MAPBLOCKSHIFT;
-	    blocky = (thing->y - bmaporgy)>>MAPBLOCKSHIFT;
-
 	    if (blockx>=0 && blockx < bmapwidth
 		&& blocky>=0 && blocky <bmapheight)
 	    {
 		blocklinks[blocky*bmapwidth+blockx] = thing->bnext;
 	    }
 	}
+
+	if (blockx>=0 && blockx < bmapwidth
+	    && blocky>=0 && blocky <bmapheight)
+	{
+	    P_RemoveBlockThing(&blockthings[blocky*bmapwidth+blockx], thing);
+	}
     }
 }
 
@@ -435,6 +495,8 @@ P_SetThingPosition (mobj_t* thing)
 		(*link)->bprev = thing;
 
 	    *link = thing;
+
+	    P_AddBlockThing(&blockthings[blocky*bmapwidth+blockx], thing);
 	}
 	else
 	{
@@ -470,7 +532,8 @@ P_BlockLinesIterator
   boolean(*func)(line_t*) )
 {
     int			offset;
-    short*		list;
+    line_t**		list;
+    line_t**		end;
     line_t*		ld;
 	
     if (x<0
@@ -482,12 +545,13 @@ P_BlockLinesIterator
     }
     
     offset = y*bmapwidth+x;
-	
-    offset = *(blockmap+offset);
 
-    for ( list = blockmaplump+offset ; *list != -1 ; list++)
+    list = blocklinelist + blocklineoffsets[offset];
+    end = blocklinelist + blocklineoffsets[offset+1];
+
+    for ( ; list != end ; list++)
     {
-	ld = &lines[*list];
+	ld = *list;
 
 	if (ld->validcount == validcount)
 	    continue; 	// line has already been checked
@@ -510,7 +574,10 @@ P_BlockThingsIterator
   int			y,
   boolean(*func)(mobj_t*) )
 {
+    blockthings_t*	block;
     mobj_t*		mobj;
+    int			changes;
+    int			i;
 	
     if ( x<0
 	 || y<0
@@ -520,13 +587,29 @@ P_BlockThingsIterator
 	return true;
     }
     
+    block = &blockthings[y*bmapwidth+x];
 
-    for (mobj = blocklinks[y*bmapwidth+x] ;
-	 mobj ;
-	 mobj = mobj->bnext)
+    for (i = block->numthings-1 ; i >= 0 ; i--)
     {
+	mobj = block->things[i];
+	changes = block->changes;
+
 	if (!func( mobj ) )
 	    return false;
+
+	if (block->changes != changes)
+	{
+	    // func (un)linked things in this block. Carry on along
+	    // the chain instead, to visit exactly what it would.
+	    for (mobj = mobj->bnext ;
+		 mobj ;
+		 mobj = mobj->bnext)
+	    {
+		if (!func( mobj ) )
+		    return false;
+	    }
+	    break;
+	}
     }
     return true;
 }
@@ -536,8 +619,9 @@ P_BlockThingsIterator
 //
 // INTERCEPT ROUTINES
 //
-intercept_t	intercepts[MAXINTERCEPTS];
+intercept_t*	intercepts = NULL;
 intercept_t*	intercept_p;
+static int	maxintercepts = 0;
 
 divline_t 	trace;
 boolean 	earlyout;
@@ -545,6 +629,30 @@ int		ptflags;
 
 static void InterceptsOverrun(int num_intercepts, intercept_t *intercept);
 
+//
+// P_CheckIntercepts
+// Make room for one more intercept.
+//
+static void P_CheckIntercepts (void)
+{
+    int		count;
+
+    count = intercept_p - intercepts;
+
+    if (count == maxintercepts)
+    {
+	maxintercepts = maxintercepts ? maxintercepts * 2 : MAXINTERCEPTS;
+	intercepts = realloc(intercepts, maxintercepts * sizeof(intercept_t));
+
+	if (intercepts == NULL)
+	{
+	    I_Error ("P_CheckIntercepts: Couldn't realloc intercepts");
+	}
+
+	intercept_p = intercepts + count;
+    }
+}
+
 //
 // PIT_AddLineIntercepts.
 // Looks for lines in the given block
@@ -597,6 +705,7 @@ PIT_AddLineIntercepts (line_t* ld)
     }
     
 	
+    P_CheckIntercepts ();
     intercept_p->frac = frac;
     intercept_p->isaline = true;
     intercept_p->d.line = ld;
@@ -663,6 +772,7 @@ boolean PIT_AddThingIntercepts (mobj_t* thing)
     if (frac < 0)
 	return true;		// behind source
 
+    P_CheckIntercepts ();
     intercept_p->frac = frac;
     intercept_p->isaline = false;
     intercept_p->d.thing = thing;
@@ -683,46 +793,36 @@ P_TraverseIntercepts
 ( traverser_t	func,
   fixed_t	maxfrac )
 {
-    int			count;
-    fixed_t		dist;
     intercept_t*	scan;
     intercept_t*	in;
-	
-    count = intercept_p - intercepts;
-    
-    in = 0;			// shut up compiler warning
-	
-    while (count--)
+    intercept_t*	end;
+    intercept_t		temp;
+
+    // Drop the intercepts out of range and sort the rest by distance,
+    // with an insertion sort: intercepts are found block by block
+    // along the trace, so they are nearly sorted already.  It is
+    // stable, so intercepts at the same distance are visited in the
+    // order they were found, like when searching for the closest
+    // remaining one each time.
+    end = intercepts;
+
+    for (scan = intercepts ; scan<intercept_p ; scan++)
     {
-	dist = INT_MAX;
-	for (scan = intercepts ; scan<intercept_p ; scan++)
-	{
-	    if (scan->frac < dist)
-	    {
-		dist = scan->frac;
-		in = scan;
-	    }
-	}
-	
-	if (dist > maxfrac)
-	    return true;	// checked everything in range		
+	if (scan->frac > maxfrac)
+	    continue;
 
-#if 0  // UNUSED
-    {
-	// don't check these yet, there may be others inserted
-	in = scan = intercepts;
-	for ( scan = intercepts ; scan<intercept_p ; scan++)
-	    if (scan->frac > maxfrac)
-		*in++ = *scan;
-	intercept_p = in;
-	return false;
+	temp = *scan;
+
+	for (in = end++ ; in > intercepts && (in-1)->frac > temp.frac ; in--)
+	    *in = *(in-1);
+
+	*in = temp;
     }
-#endif
 
-        if ( !func (in) )
+    for (scan = intercepts ; scan<end ; scan++)
+    {
+        if ( !func (scan) )
 	    return false;	// don't bother going farther
-
-	in->frac = INT_MAX;
     }
 	
     return true;		// everything was traversed
@@ -68,8 +68,13 @@ P_SetMobjState
 
 	// Modified handling.
 	// Call action functions when the state is set
-	if (st->action.acp1)		
-	    st->action.acp1(mobj);	
+	if (st->action.acp1)
+	{
+	    if (thinkerprofiling)
+		P_ProfileAction(mobj, st);
+	    else
+		st->action.acp1(mobj);
+	}
 	
 	state = st->nextstate;
     } while (!mobj->tics);
@@ -1549,6 +1549,7 @@ void P_UnArchiveWorld (void)
 	sec->tag = saveg_read16();		// needed?
 	sec->specialdata = 0;
 	sec->soundtarget = 0;
+	P_SoundSectorMoved (sec);
     }
     
     // do lines
@@ -53,6 +53,7 @@ vertex_t*	vertexes;
 
 int		numsegs;
 seg_t*		segs;
+rendseg_t*	rendsegs;
 
 int		numsectors;
 sector_t*	sectors;
@@ -89,6 +90,10 @@ fixed_t		bmaporgx;
 fixed_t		bmaporgy;
 // for thing chains
 mobj_t**	blocklinks;		
+// for iterating thing chains and blockmap lists
+blockthings_t*	blockthings;
+int*		blocklineoffsets;
+line_t**	blocklinelist;
 
 
 // REJECT
@@ -227,6 +232,21 @@ void P_LoadSegs (int lump)
     }
 	
     W_ReleaseLumpNum(lump);
+
+    // Pack what the renderer needs to reject segs and set up walls.
+    // Vertices and sector references never change within a level.
+    rendsegs = Z_Malloc (numsegs*sizeof(rendseg_t),PU_LEVEL,0);
+
+    for (i=0 ; i<numsegs ; i++)
+    {
+	rendsegs[i].v1x = segs[i].v1->x;
+	rendsegs[i].v1y = segs[i].v1->y;
+	rendsegs[i].v2x = segs[i].v2->x;
+	rendsegs[i].v2y = segs[i].v2->y;
+	rendsegs[i].angle = segs[i].angle;
+	rendsegs[i].offset = segs[i].offset;
+	rendsegs[i].backsector = segs[i].backsector;
+    }
 }
 
 
@@ -533,6 +553,49 @@ void P_LoadBlockMap (int lump)
     count = sizeof(*blocklinks) * bmapwidth * bmapheight;
     blocklinks = Z_Malloc(count, PU_LEVEL, 0);
     memset(blocklinks, 0, count);
+
+    count = sizeof(*blockthings) * bmapwidth * bmapheight;
+    blockthings = Z_Malloc(count, PU_LEVEL, 0);
+    memset(blockthings, 0, count);
+}
+
+
+//
+// P_BuildBlockLines
+// Flattens the blockmap lists into arrays of line pointers.
+// Lines are listed exactly as in the BLOCKMAP lump, including
+// the leading line 0 of every list.
+//
+static void P_BuildBlockLines (void)
+{
+    int		numblocks;
+    int		numrefs;
+    int		i;
+    short*	list;
+
+    numblocks = bmapwidth * bmapheight;
+    blocklineoffsets = Z_Malloc((numblocks + 1) * sizeof(int), PU_LEVEL, 0);
+
+    numrefs = 0;
+
+    for (i=0 ; i<numblocks ; i++)
+    {
+	blocklineoffsets[i] = numrefs;
+
+	for (list = blockmaplump+blockmap[i] ; *list != -1 ; list++)
+	    numrefs++;
+    }
+
+    blocklineoffsets[numblocks] = numrefs;
+    blocklinelist = Z_Malloc(numrefs * sizeof(line_t *), PU_LEVEL, 0);
+
+    numrefs = 0;
+
+    for (i=0 ; i<numblocks ; i++)
+    {
+	for (list = blockmaplump+blockmap[i] ; *list != -1 ; list++)
+	    blocklinelist[numrefs++] = &lines[*list];
+    }
 }
 
 
@@ -766,6 +829,9 @@ P_SetupLevel
     // Make sure all sounds are stopped before Z_FreeTags.
     S_Start ();			
 
+    // Let go of the last level's flats.
+    R_ReleaseFlats ();
+
     Z_FreeTags (PU_LEVEL, PU_PURGELEVEL-1);
 
     // UNUSED W_Profile ();
@@ -799,11 +865,13 @@ P_SetupLevel
     P_LoadSideDefs (lumpnum+ML_SIDEDEFS);
 
     P_LoadLineDefs (lumpnum+ML_LINEDEFS);
+    P_BuildBlockLines ();
     P_LoadSubsectors (lumpnum+ML_SSECTORS);
     P_LoadNodes (lumpnum+ML_NODES);
     P_LoadSegs (lumpnum+ML_SEGS);
 
     P_GroupLines ();
+    P_BuildSoundGraph ();
     P_LoadReject (lumpnum+ML_REJECT);
 
     bodyqueslot = 0;
@@ -849,6 +917,7 @@ void P_Init (void)
     P_InitSwitchList ();
     P_InitPicAnims ();
     R_InitSprites (sprnames);
+    P_InitSight ();
 }
 
 
@@ -18,27 +18,67 @@
 
 
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "doomdef.h"
 
 #include "i_system.h"
+#include "m_argv.h"
 #include "p_local.h"
 
 // State.
+#include "doomstat.h"
 #include "r_state.h"
 
+// Sight checks for the tic can be worked out up front on a pool of
+// threads where the platform has them.
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+#define SIGHT_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 //
 // P_CheckSight
 //
-fixed_t		sightzstart;		// eye z of looker
-fixed_t		topslope;
-fixed_t		bottomslope;		// slopes to top and bottom of target
 
-divline_t	strace;			// from t1 to t2
-fixed_t		t2x;
-fixed_t		t2y;
+// Used by the aiming code in p_map.c.
+fixed_t		topslope;
+fixed_t		bottomslope;
 
 int		sightcounts[2];
 
+// One end of a sight line.
+typedef struct
+{
+    fixed_t	x;
+    fixed_t	y;
+    fixed_t	z;
+    fixed_t	height;
+    sector_t*	sector;
+
+} sightpoint_t;
+
+// State of a single sight check. These used to be globals, but
+// the checks are also run on several threads at once.
+typedef struct
+{
+    fixed_t	sightzstart;		// eye z of looker
+    fixed_t	topslope;
+    fixed_t	bottomslope;		// slopes to top and bottom of target
+
+    divline_t	strace;			// from t1 to t2
+    fixed_t	t2x;
+    fixed_t	t2y;
+
+    // Lines already checked are marked with stamp. When linemarks
+    // is NULL, line->validcount and validcount are used instead.
+    int*	linemarks;
+    int		stamp;
+
+} sighttrace_t;
+
 
 //
 // P_DivlineSide
@@ -125,7 +165,7 @@ P_InterceptVector2
 // Returns true
 //  if strace crosses the given subsector successfully.
 //
-boolean P_CrossSubsector (int num)
+static boolean P_CrossSubsector (sighttrace_t* tr, int num)
 {
     seg_t*		seg;
     line_t*		line;
@@ -161,15 +201,25 @@ boolean P_CrossSubsector (int num)
 	line = seg->linedef;
 
 	// allready checked other side?
-	if (line->validcount == validcount)
-	    continue;
+	if (tr->linemarks != NULL)
+	{
+	    if (tr->linemarks[line - lines] == tr->stamp)
+		continue;
+
+	    tr->linemarks[line - lines] = tr->stamp;
+	}
+	else
+	{
+	    if (line->validcount == validcount)
+		continue;
 	
-	line->validcount = validcount;
+	    line->validcount = validcount;
+	}
 
 	v1 = line->v1;
 	v2 = line->v2;
-	s1 = P_DivlineSide (v1->x,v1->y, &strace);
-	s2 = P_DivlineSide (v2->x, v2->y, &strace);
+	s1 = P_DivlineSide (v1->x,v1->y, &tr->strace);
+	s2 = P_DivlineSide (v2->x, v2->y, &tr->strace);
 
 	// line isn't crossed?
 	if (s1 == s2)
@@ -179,8 +229,8 @@ boolean P_CrossSubsector (int num)
 	divl.y = v1->y;
 	divl.dx = v2->x - v1->x;
 	divl.dy = v2->y - v1->y;
-	s1 = P_DivlineSide (strace.x, strace.y, &divl);
-	s2 = P_DivlineSide (t2x, t2y, &divl);
+	s1 = P_DivlineSide (tr->strace.x, tr->strace.y, &divl);
+	s2 = P_DivlineSide (tr->t2x, tr->t2y, &divl);
 
 	// line isn't crossed?
 	if (s1 == s2)
@@ -225,23 +275,23 @@ boolean P_CrossSubsector (int num)
 	if (openbottom >= opentop)	
 	    return false;		// stop
 	
-	frac = P_InterceptVector2 (&strace, &divl);
+	frac = P_InterceptVector2 (&tr->strace, &divl);
 		
 	if (front->floorheight != back->floorheight)
 	{
-	    slope = FixedDiv (openbottom - sightzstart , frac);
-	    if (slope > bottomslope)
-		bottomslope = slope;
+	    slope = FixedDiv (openbottom - tr->sightzstart , frac);
+	    if (slope > tr->bottomslope)
+		tr->bottomslope = slope;
 	}
 		
 	if (front->ceilingheight != back->ceilingheight)
 	{
-	    slope = FixedDiv (opentop - sightzstart , frac);
-	    if (slope < topslope)
-		topslope = slope;
+	    slope = FixedDiv (opentop - tr->sightzstart , frac);
+	    if (slope < tr->topslope)
+		tr->topslope = slope;
 	}
 		
-	if (topslope <= bottomslope)
+	if (tr->topslope <= tr->bottomslope)
 	    return false;		// stop				
     }
     // passed the subsector ok
@@ -255,7 +305,7 @@ boolean P_CrossSubsector (int num)
 // Returns true
 //  if strace crosses the given node successfully.
 //
-boolean P_CrossBSPNode (int bspnum)
+static boolean P_CrossBSPNode (sighttrace_t* tr, int bspnum)
 {
     node_t*	bsp;
     int		side;
@@ -263,31 +313,564 @@ boolean P_CrossBSPNode (int bspnum)
     if (bspnum & NF_SUBSECTOR)
     {
 	if (bspnum == -1)
-	    return P_CrossSubsector (0);
+	    return P_CrossSubsector (tr, 0);
 	else
-	    return P_CrossSubsector (bspnum&(~NF_SUBSECTOR));
+	    return P_CrossSubsector (tr, bspnum&(~NF_SUBSECTOR));
     }
 		
     bsp = &nodes[bspnum];
     
     // decide which side the start point is on
-    side = P_DivlineSide (strace.x, strace.y, (divline_t *)bsp);
+    side = P_DivlineSide (tr->strace.x, tr->strace.y, (divline_t *)bsp);
     if (side == 2)
 	side = 0;	// an "on" should cross both sides
 
     // cross the starting side
-    if (!P_CrossBSPNode (bsp->children[side]) )
+    if (!P_CrossBSPNode (tr, bsp->children[side]) )
 	return false;
 	
     // the partition plane is crossed here
-    if (side == P_DivlineSide (t2x, t2y,(divline_t *)bsp))
+    if (side == P_DivlineSide (tr->t2x, tr->t2y,(divline_t *)bsp))
     {
 	// the line doesn't touch the other side
 	return true;
     }
     
     // cross the ending side		
-    return P_CrossBSPNode (bsp->children[side^1]);
+    return P_CrossBSPNode (tr, bsp->children[side^1]);
+}
+
+
+//
+// P_SightRejected
+// Returns true if the REJECT table says the two sectors can't
+// possibly see each other.
+//
+static boolean P_SightRejected (sector_t* sec1, sector_t* sec2)
+{
+    int		pnum;
+    int		bytenum;
+    int		bitnum;
+
+    // Determine subsector entries in REJECT table.
+    pnum = (sec1 - sectors)*numsectors + (sec2 - sectors);
+    bytenum = pnum>>3;
+    bitnum = 1 << (pnum&7);
+
+    // Check in REJECT table.
+    return (rejectmatrix[bytenum]&bitnum) != 0;
+}
+
+
+//
+// P_TraceSight
+// Looks from the eyes of p1 to any part of p2, once the REJECT
+// table has been checked.
+//
+static boolean
+P_TraceSight
+( sighttrace_t*	tr,
+  sightpoint_t*	p1,
+  sightpoint_t*	p2 )
+{
+    tr->sightzstart = p1->z + p1->height - (p1->height>>2);
+    tr->topslope = (p2->z+p2->height) - tr->sightzstart;
+    tr->bottomslope = (p2->z) - tr->sightzstart;
+	
+    tr->strace.x = p1->x;
+    tr->strace.y = p1->y;
+    tr->t2x = p2->x;
+    tr->t2y = p2->y;
+    tr->strace.dx = p2->x - p1->x;
+    tr->strace.dy = p2->y - p1->y;
+
+    // the head node is the last node output
+    return P_CrossBSPNode (tr, numnodes-1);	
+}
+
+
+static void P_SetSightPoint (sightpoint_t* point, mobj_t* mobj)
+{
+    point->x = mobj->x;
+    point->y = mobj->y;
+    point->z = mobj->z;
+    point->height = mobj->height;
+    point->sector = mobj->subsector->sector;
+}
+
+
+static boolean P_SameSightPoint (sightpoint_t* a, sightpoint_t* b)
+{
+    return a->x == b->x && a->y == b->y
+        && a->z == b->z && a->height == b->height
+        && a->sector == b->sector;
+}
+
+
+//
+// Sight precomputation.
+//
+// Before the thinkers run, P_PrecomputeSight picks out the monsters
+// whose next state (due this tic) looks for or at a target, and
+// checks their sight to the players and to their target on a pool
+// of threads. The thinkers still run one after the other, in the
+// same order as always, and P_CheckSight only takes a result from
+// the pool if both ends are exactly where they were when it was
+// worked out and no floor or ceiling has moved since. Otherwise it
+// checks again, so the outcome is always the same as without the
+// pool, and demos stay in sync.
+//
+// Player mobjs are usually still moving when monsters look at
+// them, so their sight is also checked from where their momentum
+// will take them if nothing is in the way.
+//
+
+// Too few checks aren't worth waking up the threads for.
+#define MINSIGHTJOBS	32
+
+#define MAXSIGHTTHREADS	8
+
+typedef struct
+{
+    mobj_t*		looker;
+    sightpoint_t	from;
+    sightpoint_t	to;
+    boolean		result;
+
+} sightjob_t;
+
+static sightjob_t*	sightjobs;
+static int		numsightjobs;
+static int		maxsightjobs;
+
+// Open addressing table from looker to its first job. The jobs for
+// a looker are next to each other.
+static int*		sightjobhash;
+static int		sightjobhashsize;
+
+// Value of planechanges when the jobs were run.
+static int		sightjobplanes;
+static boolean		sightjobsvalid;
+
+static int		numsightthreads;
+static int		sighthits;
+static int		sightmisses;
+static int		sightprecomputed;
+
+// Marks for each thread; see sighttrace_t.
+static int*		sightlinemarks[MAXSIGHTTHREADS + 1];
+static int		sightlinestamps[MAXSIGHTTHREADS + 1];
+static int		sightnumlines;
+
+static unsigned int P_SightJobHash (mobj_t* looker)
+{
+    return (unsigned int) (((uintptr_t) looker >> 3) * 2654435761u);
+}
+
+
+static void P_AddSightJob (mobj_t* looker, sightpoint_t* to)
+{
+    sightjob_t*	job;
+
+    if (numsightjobs == maxsightjobs)
+    {
+	maxsightjobs = maxsightjobs ? maxsightjobs * 2 : 256;
+	sightjobs = realloc(sightjobs, maxsightjobs * sizeof(sightjob_t));
+
+	if (sightjobs == NULL)
+	{
+	    I_Error ("P_AddSightJob: Couldn't realloc sight jobs");
+	}
+    }
+
+    job = &sightjobs[numsightjobs++];
+    job->looker = looker;
+    P_SetSightPoint(&job->from, looker);
+    job->to = *to;
+}
+
+
+static void P_AddSightJobsTo (mobj_t* looker, mobj_t* target)
+{
+    sightpoint_t	point;
+    subsector_t*	sub;
+
+    P_SetSightPoint(&point, target);
+    P_AddSightJob(looker, &point);
+
+    if (target->player != NULL && (target->momx || target->momy))
+    {
+	point.x += target->momx;
+	point.y += target->momy;
+	sub = R_PointInSubsector(point.x, point.y);
+	point.sector = sub->sector;
+	P_AddSightJob(looker, &point);
+    }
+}
+
+
+static void P_RunSightJobs (int thread, int first, int last)
+{
+    sighttrace_t	tr;
+    sightjob_t*		job;
+
+    tr.linemarks = sightlinemarks[thread];
+    tr.stamp = sightlinestamps[thread];
+
+    for (job = &sightjobs[first] ; job < &sightjobs[last] ; job++)
+    {
+	if (P_SightRejected(job->from.sector, job->to.sector))
+	{
+	    job->result = false;
+	    continue;
+	}
+
+	tr.stamp++;
+	job->result = P_TraceSight(&tr, &job->from, &job->to);
+    }
+
+    sightlinestamps[thread] = tr.stamp;
+}
+
+
+#ifdef SIGHT_THREADS
+
+static pthread_t	sightthreads[MAXSIGHTTHREADS];
+static pthread_mutex_t	sightlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	sightstart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	sightdone = PTHREAD_COND_INITIALIZER;
+static int		sightbatch;
+static int		sightthreadsbusy;
+
+// The main thread takes the first share of the jobs, thread i the
+// share after it.
+static void P_SightJobShare (int thread, int* first, int* last)
+{
+    *first = numsightjobs * thread / (numsightthreads + 1);
+    *last = numsightjobs * (thread + 1) / (numsightthreads + 1);
+}
+
+
+static void *P_SightThread (void *arg)
+{
+    int		thread;
+    int		batch;
+    int		first;
+    int		last;
+
+    thread = (int) (intptr_t) arg;
+    batch = 0;
+
+    for (;;)
+    {
+	pthread_mutex_lock(&sightlock);
+
+	while (sightbatch == batch)
+	{
+	    pthread_cond_wait(&sightstart, &sightlock);
+	}
+
+	batch = sightbatch;
+	pthread_mutex_unlock(&sightlock);
+
+	P_SightJobShare(thread, &first, &last);
+	P_RunSightJobs(thread, first, last);
+
+	pthread_mutex_lock(&sightlock);
+
+	if (--sightthreadsbusy == 0)
+	{
+	    pthread_cond_signal(&sightdone);
+	}
+
+	pthread_mutex_unlock(&sightlock);
+    }
+
+    return NULL;
+}
+
+#endif
+
+
+static void P_PrintSightStats (void)
+{
+    if (sightprecomputed > 0)
+    {
+	printf("P_CheckSight: %i checks done ahead on %i threads, "
+	       "%i used, %i checked again\n",
+	       sightprecomputed, numsightthreads + 1, sighthits, sightmisses);
+    }
+}
+
+
+//
+// P_InitSight
+// Starts the threads used to precompute sight checks.
+//
+void P_InitSight (void)
+{
+#ifdef SIGHT_THREADS
+    int		i;
+    long	cpus;
+
+    //!
+    // @arg <n>
+    // @category obscure
+    //
+    // Use n threads besides the main one to work out monsters' sight
+    // checks ahead of each tic. 0 checks sight only when needed.
+    // The default is one less than the number of CPUs, up to 8.
+    //
+
+    i = M_CheckParmWithArgs("-sightthreads", 1);
+
+    if (i > 0)
+    {
+	numsightthreads = atoi(myargv[i + 1]);
+    }
+    else
+    {
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	numsightthreads = cpus > 1 ? cpus - 1 : 0;
+    }
+
+    if (numsightthreads > MAXSIGHTTHREADS)
+    {
+	numsightthreads = MAXSIGHTTHREADS;
+    }
+
+    for (i=0 ; i<numsightthreads ; i++)
+    {
+	if (pthread_create(&sightthreads[i], NULL, P_SightThread,
+	                   (void *) (intptr_t) (i + 1)) != 0)
+	{
+	    break;
+	}
+
+	pthread_detach(sightthreads[i]);
+    }
+
+    numsightthreads = i;
+
+    I_AtExit(P_PrintSightStats, false);
+#endif
+}
+
+
+//
+// P_NeedsSight
+// Returns true if the action of the mobj's next state, which is due
+// this tic, is one that checks sight.
+//
+void A_Look (mobj_t* actor);
+void A_Chase (mobj_t* actor);
+void A_CPosRefire (mobj_t* actor);
+void A_SpidRefire (mobj_t* actor);
+
+static boolean P_NeedsSight (mobj_t* mobj)
+{
+    actionf_p1	action;
+
+    if (mobj->tics != 1 || mobj->state->nextstate == S_NULL)
+	return false;
+
+    action = states[mobj->state->nextstate].action.acp1;
+
+    return action == (actionf_p1) A_Look
+        || action == (actionf_p1) A_Chase
+        || action == (actionf_p1) A_CPosRefire
+        || action == (actionf_p1) A_SpidRefire;
+}
+
+
+//
+// P_PrecomputeSight
+// Checks ahead of time the sight of every monster that is going to
+// look for or at a target this tic.
+//
+void P_PrecomputeSight (void)
+{
+    thinker_t*	th;
+    mobj_t*	mobj;
+    unsigned int hash;
+    int		i;
+
+    sightjobsvalid = false;
+    numsightjobs = 0;
+
+    if (numsightthreads == 0)
+	return;
+
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+	if (th->function.acp1 != (actionf_p1) P_MobjThinker)
+	    continue;
+
+	mobj = (mobj_t *) th;
+
+	if (mobj->player != NULL || !P_NeedsSight(mobj))
+	    continue;
+
+	for (i=0 ; i<MAXPLAYERS ; i++)
+	{
+	    if (playeringame[i] && players[i].mo != NULL
+	     && players[i].mo != mobj->target)
+	    {
+		P_AddSightJobsTo(mobj, players[i].mo);
+	    }
+	}
+
+	// Like A_Look and A_Chase, don't go near a target that has been
+	// removed or can't be shot: it may have been freed already.
+	if (mobj->target != NULL
+	 && mobj->target->thinker.function.acv != (actionf_v)(-1)
+	 && (mobj->target->flags & MF_SHOOTABLE))
+	{
+	    P_AddSightJobsTo(mobj, mobj->target);
+	}
+    }
+
+    if (numsightjobs < MINSIGHTJOBS)
+    {
+	numsightjobs = 0;
+	return;
+    }
+
+    // Each thread has its own marks for the lines it has checked.
+
+    if (sightnumlines != numlines)
+    {
+	for (i=0 ; i<=numsightthreads ; i++)
+	{
+	    free(sightlinemarks[i]);
+	    sightlinemarks[i] = calloc(numlines, sizeof(int));
+
+	    if (sightlinemarks[i] == NULL)
+	    {
+		I_Error ("P_PrecomputeSight: Couldn't allocate line marks");
+	    }
+
+	    sightlinestamps[i] = 0;
+	}
+
+	sightnumlines = numlines;
+    }
+
+    // Index the jobs by looker.
+
+    if (sightjobhashsize < numsightjobs * 2)
+    {
+	sightjobhashsize = 512;
+
+	while (sightjobhashsize < numsightjobs * 2)
+	    sightjobhashsize *= 2;
+
+	free(sightjobhash);
+	sightjobhash = malloc(sightjobhashsize * sizeof(int));
+
+	if (sightjobhash == NULL)
+	{
+	    I_Error ("P_PrecomputeSight: Couldn't allocate sight job table");
+	}
+    }
+
+    for (i=0 ; i<sightjobhashsize ; i++)
+	sightjobhash[i] = -1;
+
+    for (i=0 ; i<numsightjobs ; i++)
+    {
+	if (i > 0 && sightjobs[i - 1].looker == sightjobs[i].looker)
+	    continue;
+
+	hash = P_SightJobHash(sightjobs[i].looker);
+
+	while (sightjobhash[hash & (sightjobhashsize - 1)] >= 0)
+	    hash++;
+
+	sightjobhash[hash & (sightjobhashsize - 1)] = i;
+    }
+
+#ifdef SIGHT_THREADS
+    {
+	int	first;
+	int	last;
+
+	pthread_mutex_lock(&sightlock);
+	sightthreadsbusy = numsightthreads;
+	sightbatch++;
+	pthread_cond_broadcast(&sightstart);
+	pthread_mutex_unlock(&sightlock);
+
+	P_SightJobShare(0, &first, &last);
+	P_RunSightJobs(0, first, last);
+
+	pthread_mutex_lock(&sightlock);
+
+	while (sightthreadsbusy > 0)
+	{
+	    pthread_cond_wait(&sightdone, &sightlock);
+	}
+
+	pthread_mutex_unlock(&sightlock);
+    }
+#endif
+
+    sightprecomputed += numsightjobs;
+    sightjobplanes = planechanges;
+    sightjobsvalid = true;
+}
+
+
+//
+// P_ClearSightCache
+// Drops the results of P_PrecomputeSight once the thinkers have run.
+//
+void P_ClearSightCache (void)
+{
+    sightjobsvalid = false;
+}
+
+
+//
+// P_FindSightJob
+// Returns the precomputed result for the sight check between the
+// given points, or -1 if there isn't one.
+//
+static int P_FindSightJob (mobj_t* t1, sightpoint_t* from, sightpoint_t* to)
+{
+    unsigned int hash;
+    sightjob_t*	job;
+    int		i;
+
+    if (!sightjobsvalid || sightjobplanes != planechanges)
+	return -1;
+
+    hash = P_SightJobHash(t1);
+
+    for (;;)
+    {
+	i = sightjobhash[hash & (sightjobhashsize - 1)];
+
+	if (i < 0)
+	    return -1;
+
+	if (sightjobs[i].looker == t1)
+	    break;
+
+	hash++;
+    }
+
+    for (job = &sightjobs[i] ;
+	 job < &sightjobs[numsightjobs] && job->looker == t1 ; job++)
+    {
+	if (P_SameSightPoint(&job->from, from)
+	 && P_SameSightPoint(&job->to, to))
+	{
+	    return job->result;
+	}
+    }
+
+    return -1;
 }
 
 
@@ -302,23 +885,17 @@ P_CheckSight
 ( mobj_t*	t1,
   mobj_t*	t2 )
 {
-    int		s1;
-    int		s2;
-    int		pnum;
-    int		bytenum;
-    int		bitnum;
-    
-    // First check for trivial rejection.
+    sighttrace_t	tr;
+    sightpoint_t	p1;
+    sightpoint_t	p2;
+    int			result;
 
-    // Determine subsector entries in REJECT table.
-    s1 = (t1->subsector->sector - sectors);
-    s2 = (t2->subsector->sector - sectors);
-    pnum = s1*numsectors + s2;
-    bytenum = pnum>>3;
-    bitnum = 1 << (pnum&7);
+    P_SetSightPoint(&p1, t1);
+    P_SetSightPoint(&p2, t2);
 
-    // Check in REJECT table.
-    if (rejectmatrix[bytenum]&bitnum)
+    // First check for trivial rejection.
+
+    if (P_SightRejected(p1.sector, p2.sector))
     {
 	sightcounts[0]++;
 
@@ -330,21 +907,22 @@ P_CheckSight
     // Now look from eyes of t1 to any part of t2.
     sightcounts[1]++;
 
-    validcount++;
-	
-    sightzstart = t1->z + t1->height - (t1->height>>2);
-    topslope = (t2->z+t2->height) - sightzstart;
-    bottomslope = (t2->z) - sightzstart;
-	
-    strace.x = t1->x;
-    strace.y = t1->y;
-    t2x = t2->x;
-    t2y = t2->y;
-    strace.dx = t2->x - t1->x;
-    strace.dy = t2->y - t1->y;
+    if (sightjobsvalid)
+    {
+	result = P_FindSightJob(t1, &p1, &p2);
 
-    // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
-}
+	if (result >= 0)
+	{
+	    sighthits++;
+	    return result;
+	}
+
+	sightmisses++;
+    }
+
+    validcount++;
 
+    tr.linemarks = NULL;
 
+    return P_TraceSight(&tr, &p1, &p2);
+}
@@ -129,6 +129,9 @@ animdef_t		animdefs[] =
 anim_t		anims[MAXANIMS];
 anim_t*		lastanim;
 
+// False until the translations have been set up for this level.
+static boolean	animsvalid;
+
 
 //
 //      Animating line specials
@@ -1096,6 +1099,7 @@ void P_UpdateSpecials (void)
     int		pic;
     int		i;
     line_t*	line;
+    boolean	animated;
 
     
     //	LEVEL TIMER
@@ -1107,8 +1111,17 @@ void P_UpdateSpecials (void)
     }
     
     //	ANIMATE FLATS AND TEXTURES GLOBALLY
+    // The frames only move on every anim->speed tics, unless the
+    // translations have to be set up for a new level or savegame.
+    animated = false;
+
     for (anim = anims ; anim < lastanim ; anim++)
     {
+	if (animsvalid && leveltime % anim->speed != 0)
+	    continue;
+
+	animated = true;
+
 	for (i=anim->basepic ; i<anim->basepic+anim->numpics ; i++)
 	{
 	    pic = anim->basepic + ( (leveltime/anim->speed + i)%anim->numpics );
@@ -1119,6 +1132,11 @@ void P_UpdateSpecials (void)
 	}
     }
 
+    animsvalid = true;
+
+    if (animated)
+	translationchanges++;
+
     
     //	ANIMATE LINE SPECIALS
     for (i = 0; i < numlinespecials; i++)
@@ -1135,7 +1153,7 @@ void P_UpdateSpecials (void)
 
     
     //	DO BUTTONS
-    for (i = 0; i < MAXBUTTONS; i++)
+    for (i = 0; i < MAXBUTTONS && numbuttons > 0; i++)
 	if (buttonlist[i].btimer)
 	{
 	    buttonlist[i].btimer--;
@@ -1160,6 +1178,7 @@ void P_UpdateSpecials (void)
 		}
 		S_StartSound(&buttonlist[i].soundorg,sfx_swtchn);
 		memset(&buttonlist[i],0,sizeof(button_t));
+		numbuttons--;
 	    }
 	}
 }
@@ -1484,6 +1503,11 @@ void P_SpawnSpecials (void)
     for (i = 0;i < MAXBUTTONS;i++)
 	memset(&buttonlist[i],0,sizeof(button_t));
 
+    numbuttons = 0;
+
+    // Set up the animations for the new level on the next tic.
+    animsvalid = false;
+
     // UNUSED: no horizonal sliders.
     //	P_InitSlidingDoorFrames();
 }
@@ -175,6 +175,7 @@ typedef struct
 #define FASTDARK			15
 #define SLOWDARK			35
 
+void    T_FireFlicker (fireflicker_t* flick);
 void    P_SpawnFireFlicker (sector_t* sector);
 void    T_LightFlash (lightflash_t* flash);
 void    P_SpawnLightFlash (sector_t* sector);
@@ -245,6 +246,9 @@ typedef struct
 
 extern button_t	buttonlist[MAXBUTTONS]; 
 
+// Number of buttons in buttonlist that are counting down.
+extern int	numbuttons;
+
 void
 P_ChangeSwitchTexture
 ( line_t*	line,
@@ -604,6 +608,10 @@ typedef enum
     
 } result_e;
 
+// Counts calls to T_MovePlane, so that anything depending on floor
+// and ceiling heights can tell whether they might have changed.
+extern int	planechanges;
+
 result_e
 T_MovePlane
 ( sector_t*	sector,
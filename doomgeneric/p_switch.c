@@ -93,6 +93,7 @@ switchlist_t alphSwitchList[] =
 int		switchlist[MAXSWITCHES * 2];
 int		numswitches;
 button_t        buttonlist[MAXBUTTONS];
+int             numbuttons;
 
 //
 // P_InitSwitchList
@@ -176,6 +177,7 @@ P_StartButton
 	    buttonlist[i].btexture = texture;
 	    buttonlist[i].btimer = time;
 	    buttonlist[i].soundorg = &line->frontsector->soundorg;
+	    numbuttons++;
 	    return;
 	}
     }
@@ -18,7 +18,15 @@
 //
 
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "z_zone.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
 #include "p_local.h"
 
 #include "doomstat.h"
@@ -40,12 +48,391 @@ int	leveltime;
 thinker_t	thinkercap;
 
 
+//
+// Thinker pools.
+// Besides the thinker list, which holds every thinker in its
+// original order, thinkers are also kept in one array per class.
+// With -partitionthinkers, P_RunThinkers runs the classes one after
+// the other, walking each array instead of the whole list. Within a
+// class, thinkers still run in their list order, but the order in
+// which P_Random is called changes, so games played this way can't
+// be recorded or played back. It is for benchmarking only.
+//
+typedef enum
+{
+    thc_mobj,		// P_MobjThinker
+    thc_mover,		// floors, ceilings, doors, plats
+    thc_light,		// glowing, flickering and flashing lights
+    thc_other,		// anything else, e.g. stopped movers
+
+    NUMTHINKERCLASSES
+
+} thinkerclass_t;
+
+typedef struct
+{
+    thinker_t**	thinkers;
+    int		numthinkers;
+    int		maxthinkers;
+
+} thinkerpool_t;
+
+static thinkerpool_t	thinkerpools[NUMTHINKERCLASSES];
+
+// Thinkers added since the pools were last sorted out.
+static thinkerpool_t	newthinkers;
+
+// If false, the pools are out of sync with the thinker list and
+// have to be rebuilt before they can be used.
+static boolean		thinkerpoolsvalid;
+
+static boolean		partitionthinkers;
+
+
+static void P_AddToPool (thinkerpool_t* pool, thinker_t* thinker)
+{
+    if (pool->numthinkers == pool->maxthinkers)
+    {
+	pool->maxthinkers = pool->maxthinkers ? pool->maxthinkers * 2 : 128;
+	pool->thinkers = realloc(pool->thinkers,
+				 pool->maxthinkers * sizeof(thinker_t *));
+
+	if (pool->thinkers == NULL)
+	{
+	    I_Error ("P_AddToPool: Couldn't realloc thinker pool");
+	}
+    }
+
+    pool->thinkers[pool->numthinkers++] = thinker;
+}
+
+
+static thinkerclass_t P_ThinkerClass (thinker_t* thinker)
+{
+    actionf_p1	function;
+
+    function = thinker->function.acp1;
+
+    if (function == (actionf_p1) P_MobjThinker)
+	return thc_mobj;
+
+    if (function == (actionf_p1) T_MoveFloor
+     || function == (actionf_p1) T_MoveCeiling
+     || function == (actionf_p1) T_VerticalDoor
+     || function == (actionf_p1) T_PlatRaise)
+	return thc_mover;
+
+    if (function == (actionf_p1) T_Glow
+     || function == (actionf_p1) T_FireFlicker
+     || function == (actionf_p1) T_LightFlash
+     || function == (actionf_p1) T_StrobeFlash)
+	return thc_light;
+
+    return thc_other;
+}
+
+
+// Sort thinkers added since the last call into their pools.
+static void P_SortNewThinkers (void)
+{
+    int		i;
+    thinker_t*	thinker;
+
+    for (i=0 ; i<newthinkers.numthinkers ; i++)
+    {
+	thinker = newthinkers.thinkers[i];
+	P_AddToPool(&thinkerpools[P_ThinkerClass(thinker)], thinker);
+    }
+
+    newthinkers.numthinkers = 0;
+}
+
+
+// Rebuild the pools from the thinker list.
+static void P_RebuildThinkerPools (void)
+{
+    thinker_t*	thinker;
+    int		i;
+
+    for (i=0 ; i<NUMTHINKERCLASSES ; i++)
+	thinkerpools[i].numthinkers = 0;
+
+    newthinkers.numthinkers = 0;
+
+    for (thinker = thinkercap.next ; thinker != &thinkercap ;
+	 thinker = thinker->next)
+    {
+	P_AddToPool(&thinkerpools[P_ThinkerClass(thinker)], thinker);
+    }
+
+    thinkerpoolsvalid = true;
+}
+
+
+//
+// Thinker profiling.
+// With -profilethinkers, the time spent in each thinker call is
+// accumulated per thinker function and, for mobjs, per mobj type.
+// Action functions called through P_SetMobjState are counted too,
+// per mobj type and per state. A report is printed when the level
+// ends.
+//
+boolean		thinkerprofiling;
+
+typedef struct
+{
+    const char*	name;
+    actionf_p1	function;
+    int		calls;
+    uint64_t	time;
+
+} thinkerprofile_t;
+
+static thinkerprofile_t thinkerprofiles[] =
+{
+    { "P_MobjThinker",	(actionf_p1) P_MobjThinker },
+    { "T_MoveFloor",	(actionf_p1) T_MoveFloor },
+    { "T_MoveCeiling",	(actionf_p1) T_MoveCeiling },
+    { "T_VerticalDoor",	(actionf_p1) T_VerticalDoor },
+    { "T_PlatRaise",	(actionf_p1) T_PlatRaise },
+    { "T_Glow",		(actionf_p1) T_Glow },
+    { "T_FireFlicker",	(actionf_p1) T_FireFlicker },
+    { "T_LightFlash",	(actionf_p1) T_LightFlash },
+    { "T_StrobeFlash",	(actionf_p1) T_StrobeFlash },
+    { "(other)",	NULL },
+};
+
+typedef struct
+{
+    int		calls;
+    uint64_t	time;
+    int		actioncalls;
+    uint64_t	actiontime;
+
+} mobjprofile_t;
+
+static mobjprofile_t	mobjprofiles[NUMMOBJTYPES];
+static int		stateactioncalls[NUMSTATES];
+static uint64_t		stateactiontime[NUMSTATES];
+static int		profiledtics;
+
+// The level being profiled. By the time the report is printed, from
+// the setup of the next level, gameepisode and gamemap have moved on.
+static int		profileepisode;
+static int		profilemap;
+
+
+static void P_ResetThinkerProfile (void)
+{
+    int		i;
+
+    for (i=0 ; i<arrlen(thinkerprofiles) ; i++)
+    {
+	thinkerprofiles[i].calls = 0;
+	thinkerprofiles[i].time = 0;
+    }
+
+    memset(mobjprofiles, 0, sizeof(mobjprofiles));
+    memset(stateactioncalls, 0, sizeof(stateactioncalls));
+    memset(stateactiontime, 0, sizeof(stateactiontime));
+    profiledtics = 0;
+}
+
+
+static void P_PrintProfileLine (const char* name, int calls, uint64_t time)
+{
+    printf("  %-24s %9i %10.2f %9.3f\n", name, calls,
+           time / 1000000.0, calls ? time / 1000.0 / calls : 0.0);
+}
+
+
+static void P_PrintThinkerProfile (void)
+{
+    char	name[32];
+    int		sorted[NUMMOBJTYPES];
+    int		i;
+    int		j;
+    int		best;
+    int		tmp;
+
+    if (profiledtics == 0)
+	return;
+
+    if (gamemode == commercial)
+	printf("Thinker profile for MAP%02i, %i tics:\n",
+	       profilemap, profiledtics);
+    else
+	printf("Thinker profile for E%iM%i, %i tics:\n",
+	       profileepisode, profilemap, profiledtics);
+
+    printf("  %-24s %9s %10s %9s\n", "function", "calls", "ms", "us/call");
+
+    for (i=0 ; i<arrlen(thinkerprofiles) ; i++)
+    {
+	if (thinkerprofiles[i].calls)
+	{
+	    P_PrintProfileLine(thinkerprofiles[i].name,
+			       thinkerprofiles[i].calls,
+			       thinkerprofiles[i].time);
+	}
+    }
+
+    // Mobj types, most expensive first
+
+    for (i=0 ; i<NUMMOBJTYPES ; i++)
+	sorted[i] = i;
+
+    for (i=0 ; i<NUMMOBJTYPES ; i++)
+    {
+	best = i;
+
+	for (j=i+1 ; j<NUMMOBJTYPES ; j++)
+	    if (mobjprofiles[sorted[j]].time > mobjprofiles[sorted[best]].time)
+		best = j;
+
+	tmp = sorted[i]; sorted[i] = sorted[best]; sorted[best] = tmp;
+    }
+
+    printf("  %-24s %9s %10s %9s\n", "mobj type (doomednum)",
+           "calls", "ms", "us/call");
+
+    for (i=0 ; i<NUMMOBJTYPES ; i++)
+    {
+	j = sorted[i];
+
+	if (mobjprofiles[j].calls == 0 && mobjprofiles[j].actioncalls == 0)
+	    continue;
+
+	M_snprintf(name, sizeof(name), "%i (%i)", j, mobjinfo[j].doomednum);
+	P_PrintProfileLine(name, mobjprofiles[j].calls, mobjprofiles[j].time);
+	M_snprintf(name, sizeof(name), "  actions");
+	P_PrintProfileLine(name, mobjprofiles[j].actioncalls,
+			   mobjprofiles[j].actiontime);
+    }
+
+    printf("  %-24s %9s %10s %9s\n", "state action",
+           "calls", "ms", "us/call");
+
+    for (i=0 ; i<NUMSTATES ; i++)
+    {
+	if (stateactioncalls[i])
+	{
+	    M_snprintf(name, sizeof(name), "state %i", i);
+	    P_PrintProfileLine(name, stateactioncalls[i], stateactiontime[i]);
+	}
+    }
+
+    P_ResetThinkerProfile();
+}
+
+
+static void P_ProfileThinker (thinker_t* thinker)
+{
+    thinkerprofile_t*	profile;
+    actionf_p1		function;
+    uint64_t		start;
+    uint64_t		time;
+    int			type;
+
+    function = thinker->function.acp1;
+
+    for (profile = thinkerprofiles ; profile->function != NULL ; profile++)
+	if (profile->function == function)
+	    break;
+
+    // The mobj may be removed while thinking, but is not freed yet.
+    type = function == (actionf_p1) P_MobjThinker ?
+	   ((mobj_t *) thinker)->type : -1;
+
+    start = I_GetTimeNS();
+    function (thinker);
+    time = I_GetTimeNS() - start;
+
+    profile->calls++;
+    profile->time += time;
+
+    if (type >= 0)
+    {
+	mobjprofiles[type].calls++;
+	mobjprofiles[type].time += time;
+    }
+}
+
+
+//
+// P_ProfileAction
+// Called by P_SetMobjState instead of calling the action function
+// directly while profiling.
+//
+void P_ProfileAction (mobj_t* mobj, state_t* st)
+{
+    uint64_t	start;
+    uint64_t	time;
+    int		type;
+
+    type = mobj->type;
+
+    start = I_GetTimeNS();
+    st->action.acp1(mobj);
+    time = I_GetTimeNS() - start;
+
+    mobjprofiles[type].actioncalls++;
+    mobjprofiles[type].actiontime += time;
+    stateactioncalls[st - states]++;
+    stateactiontime[st - states] += time;
+}
+
+
 //
 // P_InitThinkers
 //
 void P_InitThinkers (void)
 {
+    static boolean	profileatexit = false;
+    int			i;
+
     thinkercap.prev = thinkercap.next  = &thinkercap;
+
+    for (i=0 ; i<NUMTHINKERCLASSES ; i++)
+	thinkerpools[i].numthinkers = 0;
+
+    newthinkers.numthinkers = 0;
+
+    //!
+    // @category obscure
+    //
+    // Run thinkers grouped by class rather than in their list order.
+    // For benchmarking only: demos will desync.
+    //
+
+    partitionthinkers = M_CheckParm("-partitionthinkers") != 0;
+
+    // Without it, the pools are never used, so don't keep them up.
+    thinkerpoolsvalid = partitionthinkers;
+
+    //!
+    // @category obscure
+    //
+    // Measure the time spent in each thinker function, mobj type and
+    // state action, and print a report at the end of each level.
+    //
+
+    thinkerprofiling = M_CheckParm("-profilethinkers") != 0;
+
+    if (thinkerprofiling)
+    {
+	// Report on the level just left, if any
+	P_PrintThinkerProfile();
+
+	profileepisode = gameepisode;
+	profilemap = gamemap;
+
+	if (!profileatexit)
+	{
+	    I_AtExit(P_PrintThinkerProfile, false);
+	    profileatexit = true;
+	}
+    }
 }
 
 
@@ -61,6 +448,11 @@ void P_AddThinker (thinker_t* thinker)
     thinker->next = &thinkercap;
     thinker->prev = thinkercap.prev;
     thinkercap.prev = thinker;
+
+    // The function is usually set after adding the thinker, so it
+    // is sorted into a pool later on.
+    if (thinkerpoolsvalid)
+	P_AddToPool(&newthinkers, thinker);
 }
 
 
@@ -88,29 +480,116 @@ void P_AllocateThinker (thinker_t*	thinker)
 
 
 
+//
+// P_RunThinker
+// Runs a single thinker, or frees it if it has been removed.
+// Returns false if the thinker was freed.
+//
+static boolean P_RunThinker (thinker_t* thinker)
+{
+    if ( thinker->function.acv == (actionf_v)(-1) )
+    {
+	// time to remove it
+	thinker->next->prev = thinker->prev;
+	thinker->prev->next = thinker->next;
+	Z_Free (thinker);
+	return false;
+    }
+
+    if (thinker->function.acp1)
+    {
+	if (thinkerprofiling)
+	    P_ProfileThinker(thinker);
+	else
+	    thinker->function.acp1 (thinker);
+    }
+
+    return true;
+}
+
+
+//
+// P_RunThinkerPools
+// Runs thinkers class by class. Thinkers added along the way
+// still get to run in the same tic, as they would at the end
+// of the thinker list.
+//
+static void P_RunThinkerPools (void)
+{
+    thinkerpool_t*	pool;
+    thinker_t*		thinker;
+    int			i;
+    int			j;
+    int			numkept;
+
+    if (!thinkerpoolsvalid)
+	P_RebuildThinkerPools();
+    else
+	P_SortNewThinkers();
+
+    for (i=0 ; i<NUMTHINKERCLASSES ; i++)
+    {
+	pool = &thinkerpools[i];
+	numkept = 0;
+
+	for (j=0 ; j<pool->numthinkers ; j++)
+	{
+	    thinker = pool->thinkers[j];
+
+	    // Keep the pool compact (and in order) as thinkers go away.
+	    pool->thinkers[numkept] = thinker;
+
+	    if (P_RunThinker(thinker))
+		numkept++;
+	}
+
+	pool->numthinkers = numkept;
+    }
+
+    numkept = 0;
+
+    for (j=0 ; j<newthinkers.numthinkers ; j++)
+    {
+	thinker = newthinkers.thinkers[j];
+	newthinkers.thinkers[numkept] = thinker;
+
+	if (P_RunThinker(thinker))
+	    numkept++;
+    }
+
+    newthinkers.numthinkers = numkept;
+    P_SortNewThinkers();
+}
+
+
 //
 // P_RunThinkers
 //
 void P_RunThinkers (void)
 {
     thinker_t*	currentthinker;
+    thinker_t*	nextthinker;
+
+    if (partitionthinkers)
+    {
+	P_RunThinkerPools();
+	return;
+    }
+
+    // Thinkers get freed below without being taken out of the pools.
+    thinkerpoolsvalid = false;
 
     currentthinker = thinkercap.next;
     while (currentthinker != &thinkercap)
     {
-	if ( currentthinker->function.acv == (actionf_v)(-1) )
-	{
-	    // time to remove it
-	    currentthinker->next->prev = currentthinker->prev;
-	    currentthinker->prev->next = currentthinker->next;
-	    Z_Free (currentthinker);
-	}
-	else
-	{
-	    if (currentthinker->function.acp1)
-		currentthinker->function.acp1 (currentthinker);
-	}
-	currentthinker = currentthinker->next;
+	nextthinker = currentthinker->next;
+
+	// Thinkers added to the end of the list by this one still
+	// run in this tic.
+	if (P_RunThinker(currentthinker))
+	    nextthinker = currentthinker->next;
+
+	currentthinker = nextthinker;
     }
 }
 
@@ -141,8 +620,14 @@ void P_Ticker (void)
     for (i=0 ; i<MAXPLAYERS ; i++)
 	if (playeringame[i])
 	    P_PlayerThink (&players[i]);
-			
+
+    P_PrecomputeSight ();
     P_RunThinkers ();
+    P_ClearSightCache ();
+
+    if (thinkerprofiling)
+	profiledtics++;
+
     P_UpdateSpecials ();
     P_RespawnSpecials ();
 
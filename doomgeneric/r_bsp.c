@@ -257,12 +257,14 @@ void R_AddLine (seg_t*	line)
     angle_t		angle2;
     angle_t		span;
     angle_t		tspan;
+    rendseg_t*		rseg;
     
     curline = line;
+    rseg = &rendsegs[line - segs];
 
     // OPTIMIZE: quickly reject orthogonal back sides.
-    angle1 = R_PointToAngle (line->v1->x, line->v1->y);
-    angle2 = R_PointToAngle (line->v2->x, line->v2->y);
+    angle1 = R_PointToAngle (rseg->v1x, rseg->v1y);
+    angle2 = R_PointToAngle (rseg->v2x, rseg->v2y);
     
     // Clip to view edges.
     // OPTIMIZE: make constant out of 2*clipangle (FIELDOFVIEW).
@@ -310,7 +312,7 @@ void R_AddLine (seg_t*	line)
     if (x1 == x2)
 	return;				
 	
-    backsector = line->backsector;
+    backsector = rseg->backsector;
 
     // Single sided line?
     if (!backsector)
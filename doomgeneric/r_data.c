@@ -154,6 +154,7 @@ byte**			texturecomposite;
 // for global animation
 int*		flattranslation;
 int*		texturetranslation;
+int		translationchanges;
 
 // needed for pre rendering
 fixed_t*	spritewidth;	
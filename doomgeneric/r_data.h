@@ -34,6 +34,10 @@ R_GetColumn
 
 // I/O, setting up the stuff.
 void R_InitData (void);
+void R_InitTextures (void);
+void R_InitFlats (void);
+void R_InitSpriteLumps (void);
+void R_InitColormaps (void);
 void R_PrecacheLevel (void);
 
 
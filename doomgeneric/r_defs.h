@@ -254,6 +254,30 @@ typedef struct
 } seg_t;
 
 
+//
+// The fields of a seg read while walking the BSP tree and
+// setting up its wall, packed together so that rejecting a
+// seg does not need to chase its vertex pointers.
+// rendsegs[] parallels segs[]. Only fields that never change
+// within a level are here: the textures and offsets of the
+// sidedef are changed by switches, scrolling walls and
+// savegames, and the linedef gets ML_MAPPED written anyway.
+//
+typedef struct
+{
+    fixed_t	v1x;
+    fixed_t	v1y;
+    fixed_t	v2x;
+    fixed_t	v2y;
+
+    angle_t	angle;
+    fixed_t	offset;
+
+    sector_t*	backsector;
+
+} rendseg_t;
+
+
 
 //
 // BSP node.
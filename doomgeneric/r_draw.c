@@ -929,6 +929,9 @@ R_VideoErase
     if (background_buffer != NULL)
     {
         memcpy(I_VideoBuffer + ofs, background_buffer + ofs, count); 
+
+        V_MarkRect(0, ofs / SCREENWIDTH, SCREENWIDTH,
+                   (ofs + count - 1) / SCREENWIDTH - ofs / SCREENWIDTH + 1);
     }
 } 
 
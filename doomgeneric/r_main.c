@@ -24,17 +24,22 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 
 #include "doomdef.h"
 #include "d_loop.h"
+#include "i_perf.h"
 
 #include "m_bbox.h"
 #include "m_menu.h"
+#include "z_zone.h"
 
 #include "r_local.h"
 #include "r_sky.h"
 
+#include "v_video.h"
+
 
 
 
@@ -575,9 +580,11 @@ void R_InitTextureMapping (void)
     // Scan viewangletox[] to generate xtoviewangle[]:
     //  xtoviewangle will give the smallest view angle
     //  that maps to x.	
-    for (x=0;x<=viewwidth;x++)
+    // viewangletox[] never increases, so walking x downwards
+    //  the search can carry on from where it found the last x.
+    i = 0;
+    for (x=viewwidth;x>=0;x--)
     {
-	i = 0;
 	while (viewangletox[i]>x)
 	    i++;
 	xtoviewangle[x] = (i<<ANGLETOFINESHIFT)-ANG90;
@@ -662,9 +669,29 @@ R_SetViewSize
 
 
 //
-// R_ExecuteSetViewSize
+// Tables that only depend on the view size and detail level.
+// They are kept for every combination used so far, so changing
+//  back to a view size just copies them back.
 //
-void R_ExecuteSetViewSize (void)
+typedef struct
+{
+    int			viewangletox[FINEANGLES/2];
+    angle_t		xtoviewangle[SCREENWIDTH+1];
+    fixed_t		yslope[SCREENHEIGHT];
+    fixed_t		distscale[SCREENWIDTH];
+    lighttable_t*	scalelight[LIGHTLEVELS][MAXLIGHTSCALE];
+
+} viewsizetables_t;
+
+// indexed by setblocks (3-11) and detail (0-1)
+static viewsizetables_t*	viewsizetables[12][2];
+
+
+//
+// R_InitViewSizeTables
+// Calculates the tables for the current view size.
+//
+static void R_InitViewSizeTables (void)
 {
     fixed_t	cosadj;
     fixed_t	dy;
@@ -673,6 +700,51 @@ void R_ExecuteSetViewSize (void)
     int		level;
     int		startmap; 	
 
+    R_InitTextureMapping ();
+
+    // planes
+    for (i=0 ; i<viewheight ; i++)
+    {
+	dy = ((i-viewheight/2)<<FRACBITS)+FRACUNIT/2;
+	dy = abs(dy);
+	yslope[i] = FixedDiv ( (viewwidth<<detailshift)/2*FRACUNIT, dy);
+    }
+	
+    for (i=0 ; i<viewwidth ; i++)
+    {
+	cosadj = abs(finecosine[xtoviewangle[i]>>ANGLETOFINESHIFT]);
+	distscale[i] = FixedDiv (FRACUNIT,cosadj);
+    }
+    
+    // Calculate the light levels to use
+    //  for each level / scale combination.
+    for (i=0 ; i< LIGHTLEVELS ; i++)
+    {
+	startmap = ((LIGHTLEVELS-1-i)*2)*NUMCOLORMAPS/LIGHTLEVELS;
+	for (j=0 ; j<MAXLIGHTSCALE ; j++)
+	{
+	    level = startmap - j*SCREENWIDTH/(viewwidth<<detailshift)/DISTMAP;
+	    
+	    if (level < 0)
+		level = 0;
+
+	    if (level >= NUMCOLORMAPS)
+		level = NUMCOLORMAPS-1;
+
+	    scalelight[i][j] = colormaps + level*256;
+	}
+    }
+}
+
+
+//
+// R_ExecuteSetViewSize
+//
+void R_ExecuteSetViewSize (void)
+{
+    viewsizetables_t*	tables;
+    int			i;
+
     setsizeneeded = false;
 
     if (setblocks == 11)
@@ -711,49 +783,47 @@ void R_ExecuteSetViewSize (void)
     }
 
     R_InitBuffer (scaledviewwidth, viewheight);
-	
-    R_InitTextureMapping ();
-    
-    // psprite scales
-    pspritescale = FRACUNIT*viewwidth/SCREENWIDTH;
-    pspriteiscale = FRACUNIT*SCREENWIDTH/viewwidth;
-    
-    // thing clipping
-    for (i=0 ; i<viewwidth ; i++)
-	screenheightarray[i] = viewheight;
-    
-    // planes
-    for (i=0 ; i<viewheight ; i++)
+
+    if (setblocks < 0 || setblocks >= arrlen(viewsizetables)
+     || setdetail < 0 || setdetail > 1)
     {
-	dy = ((i-viewheight/2)<<FRACBITS)+FRACUNIT/2;
-	dy = abs(dy);
-	yslope[i] = FixedDiv ( (viewwidth<<detailshift)/2*FRACUNIT, dy);
+	// Not a size the menu can select; don't bother keeping it.
+	R_InitViewSizeTables ();
     }
-	
-    for (i=0 ; i<viewwidth ; i++)
+    else if (viewsizetables[setblocks][setdetail] != NULL)
     {
-	cosadj = abs(finecosine[xtoviewangle[i]>>ANGLETOFINESHIFT]);
-	distscale[i] = FixedDiv (FRACUNIT,cosadj);
+	tables = viewsizetables[setblocks][setdetail];
+
+	memcpy(viewangletox, tables->viewangletox, sizeof(viewangletox));
+	memcpy(xtoviewangle, tables->xtoviewangle, sizeof(xtoviewangle));
+	memcpy(yslope, tables->yslope, sizeof(yslope));
+	memcpy(distscale, tables->distscale, sizeof(distscale));
+	memcpy(scalelight, tables->scalelight, sizeof(scalelight));
+
+	clipangle = xtoviewangle[0];
     }
-    
-    // Calculate the light levels to use
-    //  for each level / scale combination.
-    for (i=0 ; i< LIGHTLEVELS ; i++)
+    else
     {
-	startmap = ((LIGHTLEVELS-1-i)*2)*NUMCOLORMAPS/LIGHTLEVELS;
-	for (j=0 ; j<MAXLIGHTSCALE ; j++)
-	{
-	    level = startmap - j*SCREENWIDTH/(viewwidth<<detailshift)/DISTMAP;
-	    
-	    if (level < 0)
-		level = 0;
+	R_InitViewSizeTables ();
 
-	    if (level >= NUMCOLORMAPS)
-		level = NUMCOLORMAPS-1;
+	tables = Z_Malloc(sizeof(*tables), PU_STATIC, NULL);
 
-	    scalelight[i][j] = colormaps + level*256;
-	}
+	memcpy(tables->viewangletox, viewangletox, sizeof(viewangletox));
+	memcpy(tables->xtoviewangle, xtoviewangle, sizeof(xtoviewangle));
+	memcpy(tables->yslope, yslope, sizeof(yslope));
+	memcpy(tables->distscale, distscale, sizeof(distscale));
+	memcpy(tables->scalelight, scalelight, sizeof(scalelight));
+
+	viewsizetables[setblocks][setdetail] = tables;
     }
+    
+    // psprite scales
+    pspritescale = FRACUNIT*viewwidth/SCREENWIDTH;
+    pspriteiscale = FRACUNIT*SCREENWIDTH/viewwidth;
+    
+    // thing clipping
+    for (i=0 ; i<viewwidth ; i++)
+	screenheightarray[i] = viewheight;
 }
 
 
@@ -768,6 +838,19 @@ void R_Init (void)
 {
     R_InitData ();
     printf (".");
+    R_InitView ();
+}
+
+
+//
+// R_InitView
+// Everything but the texture, flat and sprite tables from R_InitData.
+// This is enough for drawing screens and menus; the colormaps have to
+// be loaded first.
+//
+
+void R_InitView (void)
+{
     R_InitPointToAngle ();
     printf (".");
     R_InitTables ();
@@ -874,17 +957,25 @@ void R_RenderPlayerView (player_t* player)
     NetUpdate ();
 
     // The head node is the last node output.
+    I_PerfBegin (PERF_BSP);
     R_RenderBSPNode (numnodes-1);
+    I_PerfEnd (PERF_BSP, scaledviewwidth*viewheight);
     
     // Check for new console commands.
     NetUpdate ();
     
+    I_PerfBegin (PERF_PLANES);
     R_DrawPlanes ();
+    I_PerfEnd (PERF_PLANES, scaledviewwidth*viewheight);
     
     // Check for new console commands.
     NetUpdate ();
     
+    I_PerfBegin (PERF_MASKED);
     R_DrawMasked ();
+    I_PerfEnd (PERF_MASKED, scaledviewwidth*viewheight);
+
+    V_MarkRect (viewwindowx, viewwindowy, scaledviewwidth, viewheight);
 
     // Check for new console commands.
     NetUpdate ();				
@@ -153,6 +153,7 @@ void R_RenderPlayerView (player_t *player);
 
 // Called by startup code.
 void R_Init (void);
+void R_InitView (void);
 
 // Called by M_Responder.
 void R_SetViewSize (int blocks, int detail);
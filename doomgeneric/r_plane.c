@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "i_system.h"
 #include "z_zone.h"
@@ -85,6 +86,102 @@ fixed_t			cacheddistance[SCREENHEIGHT];
 fixed_t			cachedxstep[SCREENHEIGHT];
 fixed_t			cachedystep[SCREENHEIGHT];
 
+//
+// Flats drawn by R_DrawPlanes stay locked in flatdata, by the flat
+// number actually drawn, instead of being cached and released for
+// every visplane. When translationchanges says the animations have
+// moved on, the frames that nothing maps to any more are let go.
+//
+static byte**		flatdata;
+static byte*		flatinuse;
+static int		flatchanges;
+
+
+static void R_ReleaseFlat (int flat)
+{
+    // Someone else may have released it in the meantime, and it may
+    // have been purged since.
+    if (W_IsLumpData(firstflat + flat, flatdata[flat]))
+	W_ReleaseLumpNum(firstflat + flat);
+
+    flatdata[flat] = NULL;
+}
+
+
+//
+// R_ReleaseFlats
+// Unlocks all the flats held by R_DrawPlanes, eg. for a new level.
+//
+void R_ReleaseFlats (void)
+{
+    int		i;
+
+    if (flatdata == NULL)
+	return;
+
+    for (i=0 ; i<numflats ; i++)
+    {
+	if (flatdata[i] != NULL)
+	    R_ReleaseFlat(i);
+    }
+}
+
+
+//
+// R_UpdateFlats
+// Lets go of animation frames that aren't shown any more.
+//
+static void R_UpdateFlats (void)
+{
+    int		i;
+
+    if (flatdata == NULL)
+    {
+	flatdata = Z_Malloc(numflats * sizeof(*flatdata), PU_STATIC, 0);
+	flatinuse = Z_Malloc(numflats, PU_STATIC, 0);
+	memset(flatdata, 0, numflats * sizeof(*flatdata));
+	flatchanges = translationchanges;
+    }
+
+    if (flatchanges == translationchanges)
+	return;
+
+    memset(flatinuse, 0, numflats);
+
+    for (i=0 ; i<numflats ; i++)
+	flatinuse[flattranslation[i]] = 1;
+
+    for (i=0 ; i<numflats ; i++)
+    {
+	if (flatdata[i] != NULL && !flatinuse[i])
+	    R_ReleaseFlat(i);
+    }
+
+    flatchanges = translationchanges;
+}
+
+
+//
+// R_GetFlatSource
+// Returns the data to draw for the given (untranslated) flat.
+//
+static byte *R_GetFlatSource (int picnum)
+{
+    int		flat;
+
+    flat = flattranslation[picnum];
+
+    // Something else may have cached the lump with a purgable tag
+    // since, so make sure it's still there.
+    if (flatdata[flat] == NULL
+     || !W_IsLumpData(firstflat + flat, flatdata[flat]))
+    {
+	flatdata[flat] = W_CacheLumpNum(firstflat + flat, PU_STATIC);
+    }
+
+    return flatdata[flat];
+}
+
 
 
 //
@@ -364,7 +461,6 @@ void R_DrawPlanes (void)
     int			x;
     int			stop;
     int			angle;
-    int                 lumpnum;
 				
 #ifdef RANGECHECK
     if (ds_p - drawsegs > MAXDRAWSEGS)
@@ -380,6 +476,8 @@ void R_DrawPlanes (void)
 		 lastopening - openings);
 #endif
 
+    R_UpdateFlats ();
+
     for (pl = visplanes ; pl < lastvisplane ; pl++)
     {
 	if (pl->minx > pl->maxx)
@@ -414,8 +512,7 @@ void R_DrawPlanes (void)
 	}
 	
 	// regular flat
-        lumpnum = firstflat + flattranslation[pl->picnum];
-	ds_source = W_CacheLumpNum(lumpnum, PU_STATIC);
+	ds_source = R_GetFlatSource(pl->picnum);
 	
 	planeheight = abs(pl->height-viewz);
 	light = (pl->lightlevel >> LIGHTSEGSHIFT)+extralight;
@@ -440,7 +537,5 @@ void R_DrawPlanes (void)
 			pl->top[x],
 			pl->bottom[x]);
 	}
-	
-        W_ReleaseLumpNum(lumpnum);
     }
 }
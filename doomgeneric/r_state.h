@@ -50,11 +50,15 @@ extern int		scaledviewwidth;
 extern int		viewheight;
 
 extern int		firstflat;
+extern int		numflats;
 
 // for global animation
 extern int*		flattranslation;	
 extern int*		texturetranslation;	
 
+// Bumped whenever the translations above change.
+extern int		translationchanges;
+
 
 // Sprite....
 extern int		firstspritelump;
@@ -74,6 +78,7 @@ extern vertex_t*	vertexes;
 
 extern int		numsegs;
 extern seg_t*		segs;
+extern rendseg_t*	rendsegs;
 
 extern int		numsectors;
 extern sector_t*	sectors;
@@ -63,22 +63,52 @@
 #define NORM_PRIORITY 64
 #define NORM_SEP 128
 
-typedef struct
-{
-    // sound information (if null, channel avail.)
-    sfxinfo_t *sfxinfo;
+// Most channels that can be used; one bit of freechannels each.
 
-    // origin of sound
-    mobj_t *origin;
+#define MAX_CHANNELS 64
 
-    // handle of the sound being played
-    int handle;
-    
-} channel_t;
+// Positional sounds only get new parameters sent to the sound module
+// once they have moved this far from what was last sent.
+
+#define S_PARAM_THRESHOLD 2
+
+// The set of channels available. Each field is kept in an array of
+// its own, so that looking through the channels for an origin or a
+// priority only touches that field.
+
+// sound information (if null, channel avail.)
+static sfxinfo_t **channel_sfxinfo;
+
+// origin of sound
+static mobj_t **channel_origin;
+
+// handle of the sound being played
+static int *channel_handle;
+
+// priority of the sound, copied from its sfxinfo
+static int *channel_priority;
+
+// volume and separation last sent to the sound module
+static int *channel_volume;
+static int *channel_sep;
+
+// where the origin was when they were worked out, and whether they
+// have to be worked out again regardless
+static fixed_t *channel_x;
+static fixed_t *channel_y;
+static boolean *channel_moved;
+
+// One bit for each channel not in use
+
+static uint64_t freechannels;
 
-// The set of channels available
+// Where the listener was at the last S_UpdateSounds
 
-static channel_t *channels;
+static mobj_t *last_listener;
+static fixed_t last_listener_x;
+static fixed_t last_listener_y;
+static angle_t last_listener_angle;
+static int last_sfx_volume;
 
 // Maximum volume of a sound effect.
 // Internal default is max out of 0-15.
@@ -115,22 +145,39 @@ void S_Init(int sfxVolume, int musicVolume)
 {  
     int i;
 
-    I_PrecacheSounds(S_sfx, NUMSFX);
-
     S_SetSfxVolume(sfxVolume);
     S_SetMusicVolume(musicVolume);
 
+    if (snd_channels > MAX_CHANNELS)
+    {
+        snd_channels = MAX_CHANNELS;
+    }
+
     // Allocating the internal channels for mixing
     // (the maximum numer of sounds rendered
     // simultaneously) within zone memory.
-    channels = Z_Malloc(snd_channels*sizeof(channel_t), PU_STATIC, 0);
+    channel_sfxinfo = Z_Malloc(snd_channels * sizeof(*channel_sfxinfo),
+                               PU_STATIC, 0);
+    channel_origin = Z_Malloc(snd_channels * sizeof(*channel_origin),
+                              PU_STATIC, 0);
+    channel_handle = Z_Malloc(snd_channels * sizeof(int), PU_STATIC, 0);
+    channel_priority = Z_Malloc(snd_channels * sizeof(int), PU_STATIC, 0);
+    channel_volume = Z_Malloc(snd_channels * sizeof(int), PU_STATIC, 0);
+    channel_sep = Z_Malloc(snd_channels * sizeof(int), PU_STATIC, 0);
+    channel_x = Z_Malloc(snd_channels * sizeof(fixed_t), PU_STATIC, 0);
+    channel_y = Z_Malloc(snd_channels * sizeof(fixed_t), PU_STATIC, 0);
+    channel_moved = Z_Malloc(snd_channels * sizeof(boolean), PU_STATIC, 0);
 
     // Free all channels for use
     for (i=0 ; i<snd_channels ; i++)
     {
-        channels[i].sfxinfo = 0;
+        channel_sfxinfo[i] = NULL;
+        channel_origin[i] = NULL;
     }
 
+    freechannels = snd_channels == 64 ? ~(uint64_t) 0
+                                      : ((uint64_t) 1 << snd_channels) - 1;
+
     // no sounds are playing, and they are not mus_paused
     mus_paused = 0;
 
@@ -143,6 +190,16 @@ void S_Init(int sfxVolume, int musicVolume)
     I_AtExit(S_Shutdown, true);
 }
 
+//
+// Loads all sound effects up front, if the sound module needs to, so
+// that they don't cause pauses when first played.  Called after S_Init.
+//
+
+void S_PrecacheSounds(void)
+{
+    I_PrecacheSounds(S_sfx, NUMSFX);
+}
+
 void S_Shutdown(void)
 {
     I_ShutdownSound();
@@ -151,37 +208,45 @@ void S_Shutdown(void)
 
 static void S_StopChannel(int cnum)
 {
-    int i;
-    channel_t *c;
-
-    c = &channels[cnum];
-
-    if (c->sfxinfo)
+    if (channel_sfxinfo[cnum])
     {
         // stop the sound playing
 
-        if (I_SoundIsPlaying(c->handle))
+        if (I_SoundIsPlaying(channel_handle[cnum]))
         {
-            I_StopSound(c->handle);
+            I_StopSound(channel_handle[cnum]);
         }
 
-        // check to see if other channels are playing the sound
-
-        for (i=0; i<snd_channels; i++)
-        {
-            if (cnum != i && c->sfxinfo == channels[i].sfxinfo)
-            {
-                break;
-            }
-        }
-        
         // degrade usefulness of sound data
 
-        c->sfxinfo->usefulness--;
-        c->sfxinfo = NULL;
+        channel_sfxinfo[cnum]->usefulness--;
+        channel_sfxinfo[cnum] = NULL;
+        channel_origin[cnum] = NULL;
+        freechannels |= (uint64_t) 1 << cnum;
     }
 }
 
+//
+// Returns the lowest channel number with its bit set in mask,
+// which must not be 0.
+//
+
+static int S_FirstChannel(uint64_t mask)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(mask);
+#else
+    int cnum;
+
+    for (cnum = 0; !(mask & 1); ++cnum)
+    {
+        mask >>= 1;
+    }
+
+    return cnum;
+#endif
+}
+
 //
 // Per level startup code.
 // Kills playing sounds at start of level,
@@ -197,7 +262,7 @@ void S_Start(void)
     //  (trust me - a good idea)
     for (cnum=0 ; cnum<snd_channels ; cnum++)
     {
-        if (channels[cnum].sfxinfo)
+        if (channel_sfxinfo[cnum])
         {
             S_StopChannel(cnum);
         }
@@ -246,7 +311,7 @@ void S_StopSound(mobj_t *origin)
 
     for (cnum=0 ; cnum<snd_channels ; cnum++)
     {
-        if (channels[cnum].sfxinfo && channels[cnum].origin == origin)
+        if (channel_sfxinfo[cnum] && channel_origin[cnum] == origin)
         {
             S_StopChannel(cnum);
             break;
@@ -258,57 +323,48 @@ void S_StopSound(mobj_t *origin)
 // S_GetChannel :
 //   If none available, return -1.  Otherwise channel #.
 //
+// S_StartSound has already stopped any sound from the same origin,
+// so this takes the lowest free channel, or failing that the lowest
+// channel playing a sound of the same or lower priority.
+//
 
 static int S_GetChannel(mobj_t *origin, sfxinfo_t *sfxinfo)
 {
     // channel number to use
     int                cnum;
-    
-    channel_t*        c;
+    uint64_t           lower;
 
-    // Find an open channel
-    for (cnum=0 ; cnum<snd_channels ; cnum++)
+    if (freechannels != 0)
     {
-        if (!channels[cnum].sfxinfo)
-        {
-            break;
-        }
-        else if (origin && channels[cnum].origin == origin)
-        {
-            S_StopChannel(cnum);
-            break;
-        }
+        cnum = S_FirstChannel(freechannels);
     }
-
-    // None available
-    if (cnum == snd_channels)
+    else
     {
         // Look for lower priority
+        lower = 0;
+
         for (cnum=0 ; cnum<snd_channels ; cnum++)
         {
-            if (channels[cnum].sfxinfo->priority >= sfxinfo->priority)
-            {
-                break;
-            }
+            lower |= (uint64_t) (channel_priority[cnum] >= sfxinfo->priority)
+                     << cnum;
         }
 
-        if (cnum == snd_channels)
+        if (lower == 0)
         {
             // FUCK!  No lower priority.  Sorry, Charlie.    
             return -1;
         }
-        else
-        {
-            // Otherwise, kick out lower priority.
-            S_StopChannel(cnum);
-        }
-    }
 
-    c = &channels[cnum];
+        // Otherwise, kick out lower priority.
+        cnum = S_FirstChannel(lower);
+        S_StopChannel(cnum);
+    }
 
     // channel is decided to be cnum.
-    c->sfxinfo = sfxinfo;
-    c->origin = origin;
+    channel_sfxinfo[cnum] = sfxinfo;
+    channel_origin[cnum] = origin;
+    channel_priority[cnum] = sfxinfo->priority;
+    freechannels &= ~((uint64_t) 1 << cnum);
 
     return cnum;
 }
@@ -472,7 +528,10 @@ void S_StartSound(void *origin_p, int sfx_id)
         sfx->lumpnum = I_GetSfxLumpNum(sfx);
     }
 
-    channels[cnum].handle = I_StartSound(sfx, cnum, volume, sep);
+    channel_handle[cnum] = I_StartSound(sfx, cnum, volume, sep);
+    channel_volume[cnum] = volume;
+    channel_sep[cnum] = sep;
+    channel_moved[cnum] = true;
 }        
 
 //
@@ -507,64 +566,99 @@ void S_UpdateSounds(mobj_t *listener)
     int                cnum;
     int                volume;
     int                sep;
-    sfxinfo_t*        sfx;
-    channel_t*        c;
+    boolean            listener_moved;
+    sfxinfo_t*         sfx;
+    mobj_t*            origin;
 
     I_UpdateSound();
 
+    // Positional sounds only need to be worked out again if they or
+    // the listener have moved since last time.
+
+    listener_moved = listener != last_listener
+                  || snd_SfxVolume != last_sfx_volume
+                  || (listener != NULL
+                   && (listener->x != last_listener_x
+                    || listener->y != last_listener_y
+                    || listener->angle != last_listener_angle));
+
+    last_listener = listener;
+    last_sfx_volume = snd_SfxVolume;
+
+    if (listener != NULL)
+    {
+        last_listener_x = listener->x;
+        last_listener_y = listener->y;
+        last_listener_angle = listener->angle;
+    }
+
     for (cnum=0; cnum<snd_channels; cnum++)
     {
-        c = &channels[cnum];
-        sfx = c->sfxinfo;
+        sfx = channel_sfxinfo[cnum];
+
+        if (sfx == NULL)
+        {
+            continue;
+        }
 
-        if (c->sfxinfo)
+        if (!I_SoundIsPlaying(channel_handle[cnum]))
         {
-            if (I_SoundIsPlaying(c->handle))
+            // if channel is allocated but sound has stopped,
+            //  free it
+            S_StopChannel(cnum);
+            continue;
+        }
+
+        // check non-local sounds for distance clipping
+        //  or modify their params
+        origin = channel_origin[cnum];
+
+        if (origin == NULL || listener == origin)
+        {
+            continue;
+        }
+
+        if (!listener_moved && !channel_moved[cnum]
+         && origin->x == channel_x[cnum] && origin->y == channel_y[cnum])
+        {
+            continue;
+        }
+
+        channel_moved[cnum] = false;
+        channel_x[cnum] = origin->x;
+        channel_y[cnum] = origin->y;
+
+        // initialize parameters
+        volume = snd_SfxVolume;
+        sep = NORM_SEP;
+
+        if (sfx->link)
+        {
+            volume += sfx->volume;
+            if (volume < 1)
             {
-                // initialize parameters
-                volume = snd_SfxVolume;
-                sep = NORM_SEP;
-
-                if (sfx->link)
-                {
-                    volume += sfx->volume;
-                    if (volume < 1)
-                    {
-                        S_StopChannel(cnum);
-                        continue;
-                    }
-                    else if (volume > snd_SfxVolume)
-                    {
-                        volume = snd_SfxVolume;
-                    }
-                }
-
-                // check non-local sounds for distance clipping
-                //  or modify their params
-                if (c->origin && listener != c->origin)
-                {
-                    audible = S_AdjustSoundParams(listener,
-                                                  c->origin,
-                                                  &volume,
-                                                  &sep);
-                    
-                    if (!audible)
-                    {
-                        S_StopChannel(cnum);
-                    }
-                    else
-                    {
-                        I_UpdateSoundParams(c->handle, volume, sep);
-                    }
-                }
+                S_StopChannel(cnum);
+                continue;
             }
-            else
+            else if (volume > snd_SfxVolume)
             {
-                // if channel is allocated but sound has stopped,
-                //  free it
-                S_StopChannel(cnum);
+                volume = snd_SfxVolume;
             }
         }
+
+        audible = S_AdjustSoundParams(listener, origin, &volume, &sep);
+
+        if (!audible)
+        {
+            S_StopChannel(cnum);
+        }
+        else if (abs(volume - channel_volume[cnum]) >= S_PARAM_THRESHOLD
+              || abs(sep - channel_sep[cnum]) >= S_PARAM_THRESHOLD)
+        {
+            I_UpdateSoundParams(channel_handle[cnum], volume, sep);
+            channel_volume[cnum] = volume;
+            channel_sep[cnum] = sep;
+        }
     }
 }
 
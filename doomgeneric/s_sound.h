@@ -31,6 +31,9 @@
 
 void S_Init(int sfxVolume, int musicVolume);
 
+// Called after S_Init, to load all sound effects up front.
+void S_PrecacheSounds(void);
+
 
 // Shut down sound 
 
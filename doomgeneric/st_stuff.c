@@ -268,6 +268,9 @@ static player_t*	plyr;
 // ST_Start() has just been called
 static boolean		st_firsttime;
 
+// st_backing_screen holds the current status bar background
+static boolean		st_backingvalid;
+
 // lump number for PLAYPAL
 static int		lu_palette;
 
@@ -418,14 +421,20 @@ void ST_refreshBackground(void)
 
     if (st_statusbaron)
     {
-        V_UseBuffer(st_backing_screen);
+        // The background only needs drawing once per ST_Start.
+        if (!st_backingvalid)
+        {
+            V_UseBuffer(st_backing_screen);
+
+	    V_DrawPatch(ST_X, 0, sbar);
 
-	V_DrawPatch(ST_X, 0, sbar);
+	    if (netgame)
+	        V_DrawPatch(ST_FX, 0, faceback);
 
-	if (netgame)
-	    V_DrawPatch(ST_FX, 0, faceback);
+            V_RestoreBuffer();
 
-        V_RestoreBuffer();
+            st_backingvalid = true;
+        }
 
 	V_CopyRect(ST_X, 0, st_backing_screen, ST_WIDTH, ST_HEIGHT, ST_X, ST_Y);
     }
@@ -1395,6 +1404,7 @@ void ST_Start (void)
     ST_initData();
     ST_createWidgets();
     st_stopped = false;
+    st_backingvalid = false;
 
 }
 
@@ -20,6 +20,7 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
@@ -30,6 +31,7 @@
 #include "deh_str.h"
 #include "i_swap.h"
 #include "i_video.h"
+#include "m_argv.h"
 #include "m_bbox.h"
 #include "m_misc.h"
 #include "v_video.h"
@@ -41,6 +43,13 @@
 #include <png.h>
 #endif
 
+// Captured frames are encoded and written out on a separate thread
+// where the platform has one; elsewhere this happens in place.
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+#define CAPTURE_THREAD
+#include <pthread.h>
+#endif
+
 // TODO: There are separate RANGECHECK defines for different games, but this
 // is common code. Fix this.
 #define RANGECHECK
@@ -58,6 +67,7 @@ byte *xlatab = NULL;
 static byte *dest_screen = NULL;
 
 int dirtybox[4]; 
+byte dirtyrows[SCREENHEIGHT];
 
 // haleyjd 08/28/10: clipping callback function for patches.
 // This is needed for Chocolate Strife, which clips patches to the screen.
@@ -75,6 +85,22 @@ void V_MarkRect(int x, int y, int width, int height)
     {
         M_AddToBox (dirtybox, x, y); 
         M_AddToBox (dirtybox, x + width-1, y + height-1); 
+
+        if (y < 0)
+        {
+            height += y;
+            y = 0;
+        }
+
+        if (y + height > SCREENHEIGHT)
+        {
+            height = SCREENHEIGHT - y;
+        }
+
+        if (height > 0)
+        {
+            memset(dirtyrows + y, 1, height);
+        }
     }
 } 
  
@@ -131,6 +157,316 @@ void V_SetPatchClipCallback(vpatchclipfunc_t func)
     patchclip_callback = func;
 }
 
+//
+// Patch cache.
+//
+// Menus, the HUD font and the intermission screens draw the same
+// patches every frame. Walking the column/post format for them every
+// time is slow, so patches that get drawn repeatedly are converted
+// to rows of opaque runs that can be copied with memcpy.
+//
+// Entries are keyed by the patch pointer, and remember which lump the
+// patch came from: if that lump is purged and something else gets
+// loaded at the same address, the entry is rebuilt. The converted
+// data is PU_CACHE, so the zone can purge it too. Patches that aren't
+// lump data, or that CompilePatch can't convert, keep an entry too, so
+// that they aren't looked up again on every draw.
+//
+
+#define PATCHCACHE_SIZE   512
+#define PATCHCACHE_PROBES 16
+
+typedef struct
+{
+    short x;
+    short length;
+} patchrun_t;
+
+typedef struct
+{
+    int width;
+    int height;
+
+    // Runs for row y are runs[rowruns[y]] to runs[rowruns[y + 1] - 1].
+    // Their pixels follow each other in pixels[].
+    int *rowruns;
+    patchrun_t *runs;
+    byte *pixels;
+} compiledpatch_t;
+
+typedef struct
+{
+    patch_t *patch;
+    int lump;
+    int draws;
+    boolean slow;
+    compiledpatch_t *compiled;
+} patchcacheentry_t;
+
+static patchcacheentry_t patchcache[PATCHCACHE_SIZE];
+static boolean nopatchcache;
+
+// Scratch space for converting a patch. This is static so that the
+// zone can't purge the patch while it is being converted.
+static byte patchpixels[SCREENWIDTH * SCREENHEIGHT];
+static byte patchmask[SCREENWIDTH * SCREENHEIGHT];
+
+static int patchcachehits, patchcachemisses;
+static int patchcachecompiles, patchcachebytes;
+
+//
+// CompilePatch
+// Converts a patch to rows of runs, or returns NULL if it's too big
+// or has posts that run past its height.
+//
+
+static compiledpatch_t *CompilePatch(patch_t *patch, compiledpatch_t **user)
+{
+    compiledpatch_t *compiled;
+    column_t *column;
+    byte *source;
+    byte *dest;
+    int width, height;
+    int numruns, numpixels;
+    int count;
+    int col, x, y;
+    int run;
+    int size;
+
+    width = SHORT(patch->width);
+    height = SHORT(patch->height);
+
+    if (width <= 0 || height <= 0
+     || width > SCREENWIDTH || height > SCREENHEIGHT)
+    {
+        return NULL;
+    }
+
+    // Draw the patch into the scratch buffer, same as V_DrawPatch.
+
+    memset(patchmask, 0, width * height);
+
+    for (col = 0; col < width; col++)
+    {
+        column = (column_t *)((byte *)patch + LONG(patch->columnofs[col]));
+
+        while (column->topdelta != 0xff)
+        {
+            source = (byte *)column + 3;
+            y = column->topdelta;
+            count = column->length;
+
+            // V_DrawPatch draws these pixels anyway.
+            if (y + count > height)
+            {
+                return NULL;
+            }
+
+            for (; count > 0; count--, y++)
+            {
+                patchpixels[y * width + col] = *source++;
+                patchmask[y * width + col] = 1;
+            }
+
+            column = (column_t *)((byte *)column + column->length + 4);
+        }
+    }
+
+    // Count the runs, and allocate space for everything at once.
+
+    numruns = 0;
+    numpixels = 0;
+
+    for (y = 0; y < height; y++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            if (patchmask[y * width + x])
+            {
+                ++numpixels;
+
+                if (x == 0 || !patchmask[y * width + x - 1])
+                {
+                    ++numruns;
+                }
+            }
+        }
+    }
+
+    size = sizeof(compiledpatch_t)
+         + (height + 1) * sizeof(int)
+         + numruns * sizeof(patchrun_t)
+         + numpixels;
+
+    compiled = Z_Malloc(size, PU_CACHE, user);
+    compiled->width = width;
+    compiled->height = height;
+    compiled->rowruns = (int *) (compiled + 1);
+    compiled->runs = (patchrun_t *) (compiled->rowruns + height + 1);
+    compiled->pixels = (byte *) (compiled->runs + numruns);
+
+    run = 0;
+    dest = compiled->pixels;
+
+    for (y = 0; y < height; y++)
+    {
+        compiled->rowruns[y] = run;
+
+        for (x = 0; x < width; x++)
+        {
+            if (!patchmask[y * width + x])
+            {
+                continue;
+            }
+
+            if (x == 0 || !patchmask[y * width + x - 1])
+            {
+                compiled->runs[run].x = x;
+                compiled->runs[run].length = 0;
+                ++run;
+            }
+
+            ++compiled->runs[run - 1].length;
+            *dest++ = patchpixels[y * width + x];
+        }
+    }
+
+    compiled->rowruns[height] = run;
+
+    ++patchcachecompiles;
+    patchcachebytes += size;
+
+    return compiled;
+}
+
+//
+// GetCompiledPatch
+// Returns the converted form of the patch, or NULL if it should be
+// drawn the slow way.
+//
+
+static compiledpatch_t *GetCompiledPatch(patch_t *patch)
+{
+    patchcacheentry_t *entry;
+    patchcacheentry_t *freeentry;
+    unsigned int hash;
+    int lump;
+    int i;
+
+    if (nopatchcache)
+    {
+        return NULL;
+    }
+
+    hash = (unsigned int) (((uintptr_t) patch >> 3) * 2654435761u);
+    entry = NULL;
+    freeentry = NULL;
+
+    for (i = 0; i < PATCHCACHE_PROBES; ++i)
+    {
+        patchcacheentry_t *e;
+
+        e = &patchcache[(hash + i) % PATCHCACHE_SIZE];
+
+        if (e->patch == patch)
+        {
+            entry = e;
+            break;
+        }
+        else if (e->patch == NULL)
+        {
+            if (freeentry == NULL)
+            {
+                freeentry = e;
+            }
+            break;
+        }
+        else if (freeentry == NULL
+              && (e->lump < 0 || !W_IsLumpData(e->lump, e->patch)))
+        {
+            // Not lump data, or its patch has been purged, so this
+            // can be reused.
+            freeentry = e;
+        }
+    }
+
+    // The address may hold a different lump by now.
+
+    if (entry != NULL && entry->lump >= 0
+     && !W_IsLumpData(entry->lump, patch))
+    {
+        freeentry = entry;
+        entry = NULL;
+    }
+
+    if (entry == NULL)
+    {
+        if (freeentry == NULL)
+        {
+            ++patchcachemisses;
+            return NULL;
+        }
+
+        entry = freeentry;
+
+        if (entry->compiled != NULL)
+        {
+            Z_Free(entry->compiled);
+        }
+
+        // Not lump data is remembered as lump -1, and drawn the slow way.
+
+        lump = W_LumpNumForData(patch);
+
+        entry->patch = patch;
+        entry->lump = lump;
+        entry->draws = 0;
+        entry->slow = lump < 0;
+    }
+
+    if (entry->slow)
+    {
+        ++patchcachemisses;
+        return NULL;
+    }
+
+    // Only convert patches that are drawn more than once.
+
+    if (entry->compiled == NULL)
+    {
+        if (++entry->draws < 2)
+        {
+            ++patchcachemisses;
+            return NULL;
+        }
+
+        if (CompilePatch(patch, &entry->compiled) == NULL)
+        {
+            entry->slow = true;
+            ++patchcachemisses;
+            return NULL;
+        }
+    }
+    else
+    {
+        ++patchcachehits;
+    }
+
+    return entry->compiled;
+}
+
+static void V_PrintPatchCacheStats(void)
+{
+    if (patchcachecompiles > 0)
+    {
+        printf("V_DrawPatch: %i patches converted (%i KB), "
+               "%i cache hits, %i misses (%.1f%% hit rate)\n",
+               patchcachecompiles, patchcachebytes / 1024,
+               patchcachehits, patchcachemisses,
+               100.0 * patchcachehits / (patchcachehits + patchcachemisses));
+    }
+}
+
 //
 // V_DrawPatch
 // Masks a column based masked pic to the screen. 
@@ -138,6 +474,7 @@ void V_SetPatchClipCallback(vpatchclipfunc_t func)
 
 void V_DrawPatch(int x, int y, patch_t *patch)
 { 
+    compiledpatch_t *compiled;
     int count;
     int col;
     column_t *column;
@@ -168,9 +505,33 @@ void V_DrawPatch(int x, int y, patch_t *patch)
 
     V_MarkRect(x, y, SHORT(patch->width), SHORT(patch->height));
 
-    col = 0;
     desttop = dest_screen + y * SCREENWIDTH + x;
 
+    compiled = GetCompiledPatch(patch);
+
+    if (compiled != NULL)
+    {
+        patchrun_t *run;
+        patchrun_t *rowend;
+
+        source = compiled->pixels;
+        run = compiled->runs;
+
+        for (y = 0; y < compiled->height; y++, desttop += SCREENWIDTH)
+        {
+            rowend = compiled->runs + compiled->rowruns[y + 1];
+
+            for (; run < rowend; run++)
+            {
+                memcpy(desttop + run->x, source, run->length);
+                source += run->length;
+            }
+        }
+
+        return;
+    }
+
+    col = 0;
     w = SHORT(patch->width);
 
     for ( ; col<w ; x++, col++, desttop++)
@@ -294,6 +655,8 @@ void V_DrawTLPatch(int x, int y, patch_t * patch)
         I_Error("Bad V_DrawTLPatch");
     }
 
+    V_MarkRect(x, y, SHORT(patch->width), SHORT(patch->height));
+
     col = 0;
     desttop = dest_screen + y * SCREENWIDTH + x;
 
@@ -342,6 +705,8 @@ void V_DrawXlaPatch(int x, int y, patch_t * patch)
             return;
     }
 
+    V_MarkRect(x, y, SHORT(patch->width), SHORT(patch->height));
+
     col = 0;
     desttop = dest_screen + y * SCREENWIDTH + x;
 
@@ -393,6 +758,8 @@ void V_DrawAltTLPatch(int x, int y, patch_t * patch)
         I_Error("Bad V_DrawAltTLPatch");
     }
 
+    V_MarkRect(x, y, SHORT(patch->width), SHORT(patch->height));
+
     col = 0;
     desttop = dest_screen + y * SCREENWIDTH + x;
 
@@ -444,6 +811,8 @@ void V_DrawShadowedPatch(int x, int y, patch_t *patch)
         I_Error("Bad V_DrawShadowedPatch");
     }
 
+    V_MarkRect(x, y, SHORT(patch->width) + 2, SHORT(patch->height) + 2);
+
     col = 0;
     desttop = dest_screen + y * SCREENWIDTH + x;
     desttop2 = dest_screen + (y + 2) * SCREENWIDTH + x + 2;
@@ -531,6 +900,8 @@ void V_DrawFilledBox(int x, int y, int w, int h, int c)
     uint8_t *buf, *buf1;
     int x1, y1;
 
+    V_MarkRect(x, y, w, h);
+
     buf = I_VideoBuffer + SCREENWIDTH * y + x;
 
     for (y1 = 0; y1 < h; ++y1)
@@ -551,6 +922,8 @@ void V_DrawHorizLine(int x, int y, int w, int c)
     uint8_t *buf;
     int x1;
 
+    V_MarkRect(x, y, w, 1);
+
     buf = I_VideoBuffer + SCREENWIDTH * y + x;
 
     for (x1 = 0; x1 < w; ++x1)
@@ -564,6 +937,8 @@ void V_DrawVertLine(int x, int y, int h, int c)
     uint8_t *buf;
     int y1;
 
+    V_MarkRect(x, y, 1, h);
+
     buf = I_VideoBuffer + SCREENWIDTH * y + x;
 
     for (y1 = 0; y1 < h; ++y1)
@@ -588,6 +963,7 @@ void V_DrawBox(int x, int y, int w, int h, int c)
  
 void V_DrawRawScreen(byte *raw)
 {
+    V_MarkRect(0, 0, SCREENWIDTH, SCREENHEIGHT);
     memcpy(dest_screen, raw, SCREENWIDTH * SCREENHEIGHT);
 }
 
@@ -596,9 +972,21 @@ void V_DrawRawScreen(byte *raw)
 // 
 void V_Init (void) 
 { 
-    // no-op!
     // There used to be separate screens that could be drawn to; these are
     // now handled in the upper layers.
+
+    //!
+    // @category obscure
+    //
+    // Always draw patches straight from their column format, without
+    // converting them for faster drawing first.
+    //
+
+    nopatchcache = M_CheckParm("-nopatchcache") > 0;
+
+    I_AtExit(V_PrintPatchCacheStats, false);
+
+    V_InitCapture();
 }
 
 // Set the buffer that the code draws to.
@@ -659,7 +1047,14 @@ void WritePCXfile(char *filename, byte *data,
     pcx_t*	pcx;
     byte*	pack;
 	
-    pcx = Z_Malloc (width*height*2+1000, PU_STATIC, NULL);
+    // This runs on the capture thread, so it must stay clear of the zone.
+    pcx = malloc (width*height*2+1000);
+
+    if (pcx == NULL)
+    {
+        printf("WritePCXfile: Out of memory writing %s\n", filename);
+        return;
+    }
 
     pcx->manufacturer = 0x0a;		// PCX id
     pcx->version = 5;			// 256 color
@@ -700,7 +1095,7 @@ void WritePCXfile(char *filename, byte *data,
     length = pack - (byte *)pcx;
     M_WriteFile (filename, pcx, length);
 
-    Z_Free (pcx);
+    free (pcx);
 }
 
 #ifdef HAVE_LIBPNG
@@ -784,16 +1179,323 @@ void WritePNGfile(char *filename, byte *data,
 }
 #endif
 
+//
+// Frame capture.
+//
+// Screenshots and the -capture stream are copied into a ring of
+// preallocated slots on the game thread, and encoded and written out
+// by the capture thread. If the ring is full the capture is dropped
+// rather than stalling the game. The ring and the thread are only set
+// up for the first screenshot, or at startup with -capture; screenshots
+// alone get a single slot.
+//
+// The stream file is a sequence of records, each starting with a tag
+// byte: 'P' is followed by a 768 byte palette (as passed to
+// I_SetPalette, before gamma correction), 'F' by a SCREENWIDTH x
+// SCREENHEIGHT frame of palette indices. A palette record applies to
+// all frames after it.
+//
+
+#ifdef CAPTURE_THREAD
+#define CAPTURE_SLOTS 8
+#else
+#define CAPTURE_SLOTS 1
+#endif
+
+typedef enum
+{
+    capture_screenshot,
+    capture_frame,
+} capturetype_t;
+
+typedef struct
+{
+    capturetype_t type;
+    boolean haspalette;
+    char filename[16];
+    byte palette[768];
+    byte pixels[SCREENWIDTH * SCREENHEIGHT];
+} captureslot_t;
+
+static captureslot_t *captureslots = NULL;
+static unsigned int numcaptureslots;
+static unsigned int capturehead, capturetail;
+
+static FILE *capturestream = NULL;
+static byte capturepalette[768];
+static boolean capturepalettechanged;
+
+static int capturedframes, droppedframes;
+static int capturedshots, droppedshots;
+
+// Number to start looking for a free screenshot name from. Earlier
+// shots may not have reached the disk yet.
+static int nextscreenshot;
+
+#ifdef CAPTURE_THREAD
+static pthread_t capturethread;
+static pthread_mutex_t capturelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t capturecond = PTHREAD_COND_INITIALIZER;
+static boolean capturequit;
+#endif
+
+static void WriteCaptureSlot(captureslot_t *slot)
+{
+    if (slot->type == capture_screenshot)
+    {
+#ifdef HAVE_LIBPNG
+        extern int png_screenshots;
+        if (png_screenshots)
+        {
+        WritePNGfile(slot->filename, slot->pixels,
+                     SCREENWIDTH, SCREENHEIGHT, slot->palette);
+        }
+        else
+#endif
+        {
+        WritePCXfile(slot->filename, slot->pixels,
+                     SCREENWIDTH, SCREENHEIGHT, slot->palette);
+        }
+        return;
+    }
+
+    if (slot->haspalette)
+    {
+        fputc('P', capturestream);
+        fwrite(slot->palette, 1, sizeof(slot->palette), capturestream);
+    }
+
+    fputc('F', capturestream);
+    fwrite(slot->pixels, 1, sizeof(slot->pixels), capturestream);
+}
+
+#ifdef CAPTURE_THREAD
+
+static void *CaptureThread(void *unused)
+{
+    captureslot_t *slot;
+
+    pthread_mutex_lock(&capturelock);
+
+    for (;;)
+    {
+        // Drain everything queued before honouring a quit request.
+        while (capturetail == capturehead && !capturequit)
+        {
+            pthread_cond_wait(&capturecond, &capturelock);
+        }
+
+        if (capturetail == capturehead)
+        {
+            break;
+        }
+
+        slot = &captureslots[capturetail % numcaptureslots];
+
+        pthread_mutex_unlock(&capturelock);
+        WriteCaptureSlot(slot);
+        pthread_mutex_lock(&capturelock);
+
+        ++capturetail;
+    }
+
+    pthread_mutex_unlock(&capturelock);
+
+    return NULL;
+}
+
+#endif
+
+// Returns a free slot, or NULL if the ring is full.
+
+static captureslot_t *GetCaptureSlot(void)
+{
+    captureslot_t *slot = NULL;
+
+#ifdef CAPTURE_THREAD
+    pthread_mutex_lock(&capturelock);
+#endif
+
+    if (capturehead - capturetail < numcaptureslots)
+    {
+        slot = &captureslots[capturehead % numcaptureslots];
+    }
+
+#ifdef CAPTURE_THREAD
+    pthread_mutex_unlock(&capturelock);
+#endif
+
+    return slot;
+}
+
+// Hands the slot returned by GetCaptureSlot over to be written.
+
+static void QueueCaptureSlot(captureslot_t *slot)
+{
+#ifdef CAPTURE_THREAD
+    pthread_mutex_lock(&capturelock);
+    ++capturehead;
+    pthread_cond_signal(&capturecond);
+    pthread_mutex_unlock(&capturelock);
+#else
+    WriteCaptureSlot(slot);
+#endif
+}
+
+static void V_ShutdownCapture(void)
+{
+#ifdef CAPTURE_THREAD
+    pthread_mutex_lock(&capturelock);
+    capturequit = true;
+    pthread_cond_signal(&capturecond);
+    pthread_mutex_unlock(&capturelock);
+
+    pthread_join(capturethread, NULL);
+#endif
+
+    if (capturestream != NULL)
+    {
+        fclose(capturestream);
+        capturestream = NULL;
+
+        printf("V_ShutdownCapture: %i frames captured, %i dropped\n",
+               capturedframes, droppedframes);
+    }
+
+    if (droppedshots > 0)
+    {
+        printf("V_ShutdownCapture: %i screenshots saved, %i dropped\n",
+               capturedshots, droppedshots);
+    }
+}
+
+// Allocate the ring and start the capture thread, if not done yet.
+
+static void V_StartCapture(void)
+{
+    if (captureslots != NULL)
+    {
+        return;
+    }
+
+    numcaptureslots = capturestream != NULL ? CAPTURE_SLOTS : 1;
+    captureslots = Z_Malloc(numcaptureslots * sizeof(*captureslots),
+                            PU_STATIC, NULL);
+
+#ifdef CAPTURE_THREAD
+    if (pthread_create(&capturethread, NULL, CaptureThread, NULL) != 0)
+    {
+        I_Error("V_StartCapture: Couldn't start the capture thread");
+    }
+#endif
+
+    I_AtExit(V_ShutdownCapture, true);
+}
+
+//
+// V_InitCapture
+//
+
+void V_InitCapture(void)
+{
+    int p;
+
+    //!
+    // @arg <file>
+    // @category obscure
+    //
+    // Write every displayed frame and palette change to the given file
+    // as raw 8-bit data, for turning into a video afterwards.
+    //
+
+    p = M_CheckParmWithArgs("-capture", 1);
+
+    if (p > 0)
+    {
+        capturestream = fopen(myargv[p + 1], "wb");
+
+        if (capturestream == NULL)
+        {
+            I_Error("V_InitCapture: Couldn't open %s", myargv[p + 1]);
+        }
+
+        V_StartCapture();
+    }
+}
+
+//
+// V_CapturePalette
+// Called whenever the palette changes, so that the stream can
+// record it with the next frame.
+//
+
+void V_CapturePalette(byte *palette)
+{
+    if (capturestream != NULL)
+    {
+        memcpy(capturepalette, palette, sizeof(capturepalette));
+        capturepalettechanged = true;
+    }
+}
+
+//
+// V_CaptureFrame
+// Called once for each frame displayed.
+//
+
+void V_CaptureFrame(void)
+{
+    captureslot_t *slot;
+
+    if (capturestream == NULL)
+    {
+        return;
+    }
+
+    slot = GetCaptureSlot();
+
+    if (slot == NULL)
+    {
+        // The palette stays pending until a frame gets through.
+        ++droppedframes;
+        return;
+    }
+
+    slot->type = capture_frame;
+    slot->haspalette = capturepalettechanged;
+
+    if (capturepalettechanged)
+    {
+        memcpy(slot->palette, capturepalette, sizeof(slot->palette));
+        capturepalettechanged = false;
+    }
+
+    memcpy(slot->pixels, I_VideoBuffer, sizeof(slot->pixels));
+
+    QueueCaptureSlot(slot);
+    ++capturedframes;
+}
+
 //
 // V_ScreenShot
 //
 
 void V_ScreenShot(char *format)
 {
+    captureslot_t *slot;
     int i;
-    char lbmname[16]; // haleyjd 20110213: BUG FIX - 12 is too small!
     char *ext;
     
+    V_StartCapture();
+
+    slot = GetCaptureSlot();
+
+    if (slot == NULL)
+    {
+        ++droppedshots;
+        return;
+    }
+
     // find a file name to save it to
 
 #ifdef HAVE_LIBPNG
@@ -808,11 +1510,11 @@ void V_ScreenShot(char *format)
         ext = "pcx";
     }
 
-    for (i=0; i<=99; i++)
+    for (i=nextscreenshot; i<=99; i++)
     {
-        M_snprintf(lbmname, sizeof(lbmname), format, i, ext);
+        M_snprintf(slot->filename, sizeof(slot->filename), format, i, ext);
 
-        if (!M_FileExists(lbmname))
+        if (!M_FileExists(slot->filename))
         {
             break;      // file doesn't exist
         }
@@ -823,21 +1525,15 @@ void V_ScreenShot(char *format)
         I_Error ("V_ScreenShot: Couldn't create a PCX");
     }
 
-#ifdef HAVE_LIBPNG
-    if (png_screenshots)
-    {
-    WritePNGfile(lbmname, I_VideoBuffer,
-                 SCREENWIDTH, SCREENHEIGHT,
-                 W_CacheLumpName (DEH_String("PLAYPAL"), PU_CACHE));
-    }
-    else
-#endif
-    {
-    // save the pcx file
-    WritePCXfile(lbmname, I_VideoBuffer,
-                 SCREENWIDTH, SCREENHEIGHT,
-                 W_CacheLumpName (DEH_String("PLAYPAL"), PU_CACHE));
-    }
+    nextscreenshot = i + 1;
+
+    slot->type = capture_screenshot;
+    memcpy(slot->palette, W_CacheLumpName (DEH_String("PLAYPAL"), PU_CACHE),
+           sizeof(slot->palette));
+    memcpy(slot->pixels, I_VideoBuffer, sizeof(slot->pixels));
+
+    QueueCaptureSlot(slot);
+    ++capturedshots;
 }
 
 #define MOUSE_SPEED_BOX_WIDTH  120
@@ -23,6 +23,7 @@
 #define __V_VIDEO__
 
 #include "doomtype.h"
+#include "i_video.h"
 
 // Needed because we are refering to patches.
 #include "v_patch.h"
@@ -36,6 +37,10 @@
 
 extern int dirtybox[4];
 
+// Nonzero for every screen row changed since I_FinishUpdate last
+// displayed the screen, so that unchanged rows can be skipped.
+extern byte dirtyrows[SCREENHEIGHT];
+
 extern byte *tinttable;
 
 // haleyjd 08/28/10: implemented for Strife support
@@ -91,6 +96,18 @@ void V_RestoreBuffer(void);
 
 void V_ScreenShot(char *format);
 
+// Set up screenshot and -capture frame capture.
+
+void V_InitCapture(void);
+
+// Record the displayed frame to the -capture stream, if there is one.
+
+void V_CaptureFrame(void);
+
+// Record a palette change to the -capture stream.
+
+void V_CapturePalette(byte *palette);
+
 // Load the lookup table for translucency calculations from the TINTTAB
 // lump.
 
@@ -467,6 +467,47 @@ void W_ReleaseLumpName(char *name)
     W_ReleaseLumpNum(W_GetNumForName(name));
 }
 
+//
+// W_IsLumpData
+// Returns true if data is where W_CacheLumpNum currently has the
+// given lump, ie. the lump has not been purged since.
+//
+
+boolean W_IsLumpData(int lumpnum, void *data)
+{
+    lumpinfo_t *lump;
+
+    lump = &lumpinfo[lumpnum];
+
+    if (lump->wad_file->mapped != NULL)
+    {
+        return data == lump->wad_file->mapped + lump->position;
+    }
+
+    return data == lump->cache;
+}
+
+//
+// W_LumpNumForData
+// Returns the lump that a pointer returned by W_CacheLumpNum belongs
+// to, or -1 if it isn't lump data (any more).
+//
+
+int W_LumpNumForData(void *data)
+{
+    unsigned int i;
+
+    for (i = 0; i < numlumps; ++i)
+    {
+        if (W_IsLumpData(i, data))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
 #if 0
 
 //
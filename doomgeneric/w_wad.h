@@ -73,6 +73,9 @@ extern unsigned int W_LumpNameHash(const char *s);
 void    W_ReleaseLumpNum(int lump);
 void    W_ReleaseLumpName(char *name);
 
+boolean W_IsLumpData(int lump, void *data);
+int     W_LumpNumForData(void *data);
+
 void W_CheckCorrectIWAD(GameMission_t mission);
 
 #endif
@@ -21,6 +21,10 @@
 #include "i_system.h"
 #include "doomtype.h"
 
+#ifdef ALLOCTRACK
+#include "i_alloctrack.h"
+#endif
+
 
 //
 // ZONE MEMORY ALLOCATION
@@ -132,6 +136,10 @@ void Z_Free (void* ptr)
 
     if (block->id != ZONEID)
 	I_Error ("Z_Free: freed a pointer without ZONEID");
+
+#ifdef ALLOCTRACK
+    I_CountZoneFree ();
+#endif
 		
     if (block->tag != PU_FREE && block->user != NULL)
     {
@@ -194,6 +202,10 @@ Z_Malloc
     memblock_t*	base;
     void *result;
 
+#ifdef ALLOCTRACK
+    I_CountZoneAlloc (size);
+#endif
+
     size = (size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
     
     // scan through the block list,
@@ -1,2 +1,2 @@
 #!/bin/sh
-AUDIODEV=plughw:1,0 SDL_AUDIODRIVER=alsa SDL_FORCE_SOUNDFONTS=1 SDL_SOUNDFONTS=TimGM6mb.sf2 LD_LIBRARY_PATH=. ./doomgeneric -iwad DOOM1.WAD
+AUDIODEV=plughw:1,0 SDL_AUDIODRIVER=alsa SDL_FORCE_SOUNDFONTS=1 SDL_SOUNDFONTS=TimGM6mb.sf2 LD_LIBRARY_PATH=. ./doomgeneric -iwad DOOM1.WAD -faststart